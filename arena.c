@@ -0,0 +1,165 @@
+
+#include <SDL3/SDL.h>
+
+#include "arena.h"
+#include "utils.h"
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK_SIZE (64 * 1024)
+#define ARENA_GROW_SIZE (1024 * 1024)
+#define ARENA_MAX_CACHE_SIZE (256 * 1024 * 1024)
+
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+typedef struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	Uint8 *data;
+} arena_block_t;
+
+struct arena {
+	SDL_SpinLock lock;
+	arena_block_t *blocks;
+};
+
+/* blocks handed back by destroyed arenas, kept around for the next file */
+static SDL_SpinLock cache_lock;
+static arena_block_t *cache;
+static size_t cache_size;
+
+static arena_block_t *get_block(size_t size)
+{
+	/* take the smallest cached block that fits */
+	SDL_LockSpinlock(&cache_lock);
+	arena_block_t **best = NULL;
+	for (arena_block_t **block = &cache; *block; block = &(*block)->next)
+		if ((*block)->size >= size && (!best || (*block)->size < (*best)->size))
+			best = block;
+
+	arena_block_t *found = NULL;
+	if (best)
+	{
+		found = *best;
+		*best = found->next;
+		cache_size -= found->size;
+	}
+	SDL_UnlockSpinlock(&cache_lock);
+
+	if (!found)
+	{
+		found = SDL_malloc(ALIGN_UP(sizeof(arena_block_t), ARENA_ALIGNMENT) + size);
+		if (!found)
+			return NULL;
+		found->size = size;
+		found->data = (Uint8 *)found + ALIGN_UP(sizeof(arena_block_t), ARENA_ALIGNMENT);
+	}
+
+	found->next = NULL;
+	found->used = 0;
+	return found;
+}
+
+arena_t *create_arena(size_t size)
+{
+	arena_t *arena = SDL_calloc(1, sizeof(arena_t));
+	if (!arena)
+		return NULL;
+
+	/* a missing first block is fine, arena_alloc() will try again */
+	arena->blocks = get_block(SDL_max(ALIGN_UP(size, ARENA_ALIGNMENT), ARENA_MIN_BLOCK_SIZE));
+	return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	size = ALIGN_UP(SDL_max(size, 1), ARENA_ALIGNMENT);
+
+	SDL_LockSpinlock(&arena->lock);
+
+	/* bump the current block, or chain on a new one if it's full */
+	arena_block_t *block = arena->blocks;
+	if (!block || block->size - block->used < size)
+	{
+		arena_block_t *next = get_block(SDL_max(size, ARENA_GROW_SIZE));
+		if (!next)
+		{
+			SDL_UnlockSpinlock(&arena->lock);
+			log_warning("Failed to allocate %zu bytes from arena", size);
+			return NULL;
+		}
+
+		/* big allocations get a block of their own, so the current one keeps its free space */
+		if (block && size >= ARENA_GROW_SIZE)
+		{
+			next->next = block->next;
+			block->next = next;
+		}
+		else
+		{
+			next->next = block;
+			arena->blocks = next;
+		}
+
+		block = next;
+	}
+
+	void *ptr = block->data + block->used;
+	block->used += size;
+
+	SDL_UnlockSpinlock(&arena->lock);
+
+	return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t count, size_t size)
+{
+	void *ptr = arena_alloc(arena, count * size);
+	if (ptr)
+		SDL_memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void destroy_arena(arena_t *arena)
+{
+	arena_block_t *block = arena->blocks;
+
+	while (block)
+	{
+		arena_block_t *next = block->next;
+
+		/* keep it for the next file unless the cache is already full */
+		SDL_LockSpinlock(&cache_lock);
+		bool keep = cache_size + block->size <= ARENA_MAX_CACHE_SIZE;
+		if (keep)
+		{
+			block->next = cache;
+			cache = block;
+			cache_size += block->size;
+		}
+		SDL_UnlockSpinlock(&cache_lock);
+
+		if (!keep)
+			SDL_free(block);
+
+		block = next;
+	}
+
+	SDL_free(arena);
+}
+
+void free_arena_cache(void)
+{
+	SDL_LockSpinlock(&cache_lock);
+	arena_block_t *block = cache;
+	cache = NULL;
+	cache_size = 0;
+	SDL_UnlockSpinlock(&cache_lock);
+
+	while (block)
+	{
+		arena_block_t *next = block->next;
+		SDL_free(block);
+		block = next;
+	}
+}
@@ -0,0 +1,76 @@
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+typedef struct arena arena_t;
+
+/**
+ * \brief create an arena to serve all the allocations for one conversion
+ *
+ * \param size expected total size of the allocations, used to size the first block
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the new arena, or NULL on error
+ *
+ * \note blocks come from a cache shared by every arena, so batches of files
+ * keep reusing the same memory
+ */
+arena_t *create_arena(size_t size);
+
+/**
+ * \brief allocate memory from an arena
+ *
+ * \param arena the arena to allocate from
+ * \param size number of bytes to allocate
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the allocated memory, aligned to 16 bytes, or NULL on error
+ *
+ * \note safe to call from several threads at once
+ * \note the memory is not zeroed and can't be freed on its own
+ * \note failures are logged, so callers only have to bail out
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * \brief allocate zeroed memory for an array from an arena
+ *
+ * \param arena the arena to allocate from
+ * \param count number of elements
+ * \param size size of each element
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the allocated memory, aligned to 16 bytes, or NULL on error
+ */
+void *arena_calloc(arena_t *arena, size_t count, size_t size);
+
+/**
+ * \brief release everything allocated from an arena
+ *
+ * \param arena the arena, which is freed
+ *
+ * \author erysdren (it/its)
+ */
+void destroy_arena(arena_t *arena);
+
+/**
+ * \brief free the blocks cached for reuse by later arenas
+ *
+ * \author erysdren (it/its)
+ *
+ * \note must not be called while any arena is alive
+ */
+void free_arena_cache(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ARENA_H_ */
@@ -0,0 +1,121 @@
+
+#include <SDL3/SDL.h>
+
+#include "batch.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+typedef struct batch {
+	int num_files;
+	char **filenames;
+	Sint64 *estimates;
+	bool *started;
+	int num_started;
+	int num_running;
+	Sint64 memory_budget;
+	Sint64 memory_reserved;
+	batch_convert_func_t convert;
+	void *userdata;
+	SDL_Mutex *mutex;
+	SDL_Condition *condition;
+} batch_t;
+
+/* must be called with the batch mutex held */
+static int pick_next_file(batch_t *batch)
+{
+	for (int i = 0; i < batch->num_files; i++)
+	{
+		if (batch->started[i])
+			continue;
+
+		if (batch->memory_budget <= 0 || batch->memory_reserved + batch->estimates[i] <= batch->memory_budget)
+			return i;
+	}
+
+	/* nothing fits, so let the first one run on its own once everything else is done */
+	if (batch->num_running == 0)
+	{
+		for (int i = 0; i < batch->num_files; i++)
+		{
+			if (!batch->started[i])
+			{
+				log_warning("\"%s\" needs %" SDL_PRIs64 " bytes, which is over the memory budget", batch->filenames[i], batch->estimates[i]);
+				return i;
+			}
+		}
+	}
+
+	return -1;
+}
+
+static void batch_worker(void *userdata, int job, int thread)
+{
+	batch_t *batch = (batch_t *)userdata;
+
+	/* every worker keeps taking files until there's none left */
+	(void)job;
+	(void)thread;
+
+	SDL_LockMutex(batch->mutex);
+
+	while (batch->num_started < batch->num_files)
+	{
+		int file = pick_next_file(batch);
+		if (file < 0)
+		{
+			SDL_WaitCondition(batch->condition, batch->mutex);
+			continue;
+		}
+
+		batch->started[file] = true;
+		batch->num_started++;
+		batch->num_running++;
+		batch->memory_reserved += batch->estimates[file];
+
+		SDL_UnlockMutex(batch->mutex);
+		batch->convert(batch->filenames[file], batch->userdata);
+		SDL_LockMutex(batch->mutex);
+
+		batch->num_running--;
+		batch->memory_reserved -= batch->estimates[file];
+		SDL_BroadcastCondition(batch->condition);
+	}
+
+	SDL_UnlockMutex(batch->mutex);
+}
+
+void run_batch(int num_files, char **filenames, int num_threads, Sint64 memory_budget, batch_estimate_func_t estimate, batch_convert_func_t convert, void *userdata)
+{
+	batch_t batch;
+	SDL_zero(batch);
+
+	batch.num_files = num_files;
+	batch.filenames = filenames;
+	batch.memory_budget = memory_budget;
+	batch.convert = convert;
+	batch.userdata = userdata;
+
+	/* one worker is the same as converting them in order */
+	if (num_threads <= 1 || num_files <= 1)
+	{
+		for (int i = 0; i < num_files; i++)
+			convert(filenames[i], userdata);
+		return;
+	}
+
+	/* estimate everything up front, headers are cheap to read */
+	batch.estimates = SDL_calloc(num_files, sizeof(Sint64));
+	batch.started = SDL_calloc(num_files, sizeof(bool));
+	for (int i = 0; i < num_files; i++)
+		batch.estimates[i] = SDL_max(estimate(filenames[i], userdata), 0);
+
+	batch.mutex = SDL_CreateMutex();
+	batch.condition = SDL_CreateCondition();
+
+	run_jobs(num_threads, num_threads, NULL, batch_worker, &batch);
+
+	SDL_DestroyCondition(batch.condition);
+	SDL_DestroyMutex(batch.mutex);
+	SDL_free(batch.started);
+	SDL_free(batch.estimates);
+}
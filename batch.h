@@ -0,0 +1,50 @@
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+/**
+ * \brief function that estimates how much memory converting a file will take
+ *
+ * \param filename the file to estimate
+ * \param userdata the userdata pointer passed to run_batch()
+ *
+ * \returns number of bytes to reserve, or -1 if the file can't be read
+ */
+typedef Sint64 (*batch_estimate_func_t)(const char *filename, void *userdata);
+
+/**
+ * \brief function that converts a file
+ *
+ * \param filename the file to convert
+ * \param userdata the userdata pointer passed to run_batch()
+ */
+typedef void (*batch_convert_func_t)(const char *filename, void *userdata);
+
+/**
+ * \brief convert a batch of files on a pool of worker threads within a memory budget
+ *
+ * Each file reserves its estimated memory before it starts, and files that
+ * don't fit in what's left of the budget are passed over for later ones that
+ * do. A file bigger than the whole budget is run on its own.
+ *
+ * \param num_files number of files
+ * \param filenames array of num_files filenames
+ * \param num_threads maximum number of files to convert at once
+ * \param memory_budget maximum number of bytes to reserve at once, or <= 0 for no limit
+ * \param estimate function to estimate the memory used by a file
+ * \param convert function to convert a file
+ * \param userdata pointer passed to estimate and convert
+ *
+ * \author erysdren (it/its)
+ */
+void run_batch(int num_files, char **filenames, int num_threads, Sint64 memory_budget, batch_estimate_func_t estimate, batch_convert_func_t convert, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _BATCH_H_ */
@@ -0,0 +1,1924 @@
+#include <SDL3/SDL.h>
+
+#include "bsp360.h"
+#include "byteswap.h"
+#include "decompress_lzma.h"
+#include "lump_schemas.h"
+#include "mapped_file.h"
+#include "memory_tracker.h"
+#include "output_file.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "utils.h"
+#include "zip360.h"
+
+SDL_COMPILE_TIME_ASSERT(bsp_header_size, sizeof(bsp_header_t) == 1036);
+
+typedef struct vector {
+	float x;
+	float y;
+	float z;
+} vector_t;
+
+typedef struct vec4 {
+	float x;
+	float y;
+	float z;
+	float w;
+} vec4_t;
+
+typedef struct node {
+	Sint32 plane_num;
+	Sint32 children[2];
+	Sint16 mins[3];
+	Sint16 maxs[3];
+	Uint16 first_face;
+	Uint16 num_faces;
+	Sint16 area;
+	Sint16 pad;
+} node_t;
+
+typedef struct areaportal {
+	Uint16 portal_key;
+	Uint16 other_area;
+	Uint16 first_clip_vert;
+	Uint16 num_clip_verts;
+	Sint32 plane_num;
+} areaportal_t;
+
+typedef struct leaf {
+	Sint32 contents;
+	Sint16 cluster;
+	Uint16 flags;
+	Sint16 mins[3];
+	Sint16 maxs[3];
+	Uint16 first_leaf_face;
+	Uint16 num_leaf_faces;
+	Uint16 first_leaf_brush;
+	Uint16 num_leaf_brushes;
+	Sint16 leaf_water_id;
+} leaf_t;
+
+typedef struct face {
+	Uint16 plane_num;
+	Uint8 side;
+	Uint8 on_node;
+	Sint32 first_edge;
+	Sint16 num_edges;
+	Sint16 tex_info;
+	Sint16 disp_info;
+	Sint16 surface_fog_volume;
+	Uint8 styles[4];
+	Sint32 light_offset;
+	float area;
+	Sint32 lightmap_mins[2];
+	Sint32 lightmap_maxs[2];
+	Sint32 original_face;
+	Uint16 num_primitives;
+	Uint16 first_primitive;
+	Uint32 smoothing_groups;
+} face_t;
+
+typedef struct primitive {
+	Uint8 type;
+	Uint16 first_index;
+	Uint16 num_indices;
+	Uint16 first_vert;
+	Uint16 num_verts;
+} primitive_t;
+
+typedef struct leaf_water_data {
+	float surface_z;
+	float min_z;
+	Sint16 tex_info;
+} leaf_water_data_t;
+
+typedef struct phys_model {
+	Sint32 model_index;
+	Sint32 len_data;
+	Sint32 len_key_data;
+	Sint32 num_solids;
+} phys_model_t;
+
+typedef struct phys_solid {
+	Sint32 id;
+	Sint16 version;
+	Sint16 type;
+} phys_solid_t;
+
+typedef struct phys_surface {
+	Sint32 surface_size;
+	vector_t axis;
+	Sint32 axis_size;
+} phys_surface_t;
+
+typedef struct phys_compact_surface {
+	vector_t mass_center;
+	vector_t rotation_inertia;
+	float upper_limit_radius;
+	Uint32 bitfields;
+	Sint32 ofs_ledgetree_root;
+} phys_compact_surface_t;
+
+typedef struct phys_compact_ledgetree_node {
+	Sint32 ofs_right_node;
+	Sint32 ofs_compact_ledge;
+	vector_t center;
+	float radius;
+	Uint8 box_sizes[3];
+	Uint8 padding;
+} phys_compact_ledgetree_node_t;
+
+typedef struct phys_compact_ledge {
+	Sint32 ofs_point_array;
+	Sint32 ofs_ledgetree_node;
+	Uint32 bitfields;
+	Sint16 num_triangles;
+	Sint16 reserved;
+} phys_compact_ledge_t;
+
+SDL_COMPILE_TIME_ASSERT(phys_compact_ledge_size, sizeof(phys_compact_ledge_t) == 16);
+
+typedef struct phys_compact_edge {
+	Uint32 start_point_index : 16;
+	Sint32 opposite_index : 15;
+	Uint32 is_virtual : 1;
+} phys_compact_edge_t;
+
+SDL_COMPILE_TIME_ASSERT(phys_compact_edge_size, sizeof(phys_compact_edge_t) == 4);
+
+typedef struct phys_compact_triangle {
+	Uint32 bitfields;
+	phys_compact_edge_t edges[3];
+} phys_compact_triangle_t;
+
+SDL_COMPILE_TIME_ASSERT(phys_compact_triangle_size, sizeof(phys_compact_triangle_t) == 16);
+
+typedef struct overlay {
+	Sint32 id;
+	Sint16 tex_info;
+	Uint16 num_faces;
+	Sint32 faces[64];
+	float u[2];
+	float v[2];
+	vector_t points[4];
+	vector_t origin;
+	vector_t normal;
+} overlay_t;
+
+typedef struct occluder_data {
+	Sint32 flags;
+	Sint32 first_poly;
+	Sint32 num_polys;
+	vector_t mins;
+	vector_t maxs;
+	Sint32 area;
+} occluder_data_t;
+
+typedef struct occluder_poly_data {
+	Sint32 first_vert;
+	Sint32 num_verts;
+	Sint32 plane_num;
+} occluder_poly_data_t;
+
+typedef struct disp_edge_neighbor {
+	Uint16 neighbor_index;
+	Uint8 neighbor_orientation;
+	Uint8 span;
+	Uint8 neighbor_span;
+} disp_edge_neighbor_t;
+
+typedef struct disp_corner_neighbor {
+	Uint16 neighbors[4];
+	Uint8 num_neighbors;
+} disp_corner_neighbor_t;
+
+typedef struct disp_info {
+	vector_t start_position;
+	Sint32 first_vert;
+	Sint32 first_tri;
+	Sint32 power;
+	Sint32 min_tess;
+	float smoothing_angle;
+	Sint32 contents;
+	Uint16 map_face;
+	Sint32 first_lightmap_alpha;
+	Sint32 first_lightmap_sample_position;
+	disp_edge_neighbor_t edge_neighbors[4][2];
+	disp_corner_neighbor_t corner_neighbors[4];
+	Uint32 allowed_verts[10];
+} disp_info_t;
+
+SDL_COMPILE_TIME_ASSERT(disp_info_size, sizeof(disp_info_t) == 176);
+
+/* the swap schemas are generated from kaitai/bsp360.ksy, make sure they still match */
+SDL_COMPILE_TIME_ASSERT(node_schema_size, sizeof(node_t) == SCHEMA_NODE_SIZE);
+SDL_COMPILE_TIME_ASSERT(face_schema_size, sizeof(face_t) == SCHEMA_FACE_SIZE);
+SDL_COMPILE_TIME_ASSERT(leaf_schema_size, sizeof(leaf_t) == SCHEMA_LEAF_SIZE);
+SDL_COMPILE_TIME_ASSERT(areaportal_schema_size, sizeof(areaportal_t) == SCHEMA_AREAPORTAL_SIZE);
+SDL_COMPILE_TIME_ASSERT(disp_info_schema_size, sizeof(disp_info_t) == SCHEMA_DISP_INFO_SIZE);
+SDL_COMPILE_TIME_ASSERT(leaf_water_data_schema_size, sizeof(leaf_water_data_t) == SCHEMA_LEAF_WATER_DATA_SIZE);
+SDL_COMPILE_TIME_ASSERT(primitive_schema_size, sizeof(primitive_t) == SCHEMA_PRIMITIVE_SIZE);
+SDL_COMPILE_TIME_ASSERT(overlay_schema_size, sizeof(overlay_t) == SCHEMA_OVERLAY_SIZE);
+
+#define CHECK_FUNNY_LUMP_SIZE(s) if (lump_size % s != 0) return false;
+#define SWAP16(x) x = SDL_Swap16(x)
+#define SWAP32(x) x = SDL_Swap32(x)
+#define SWAPFLOAT(x) x = SDL_SwapFloat(x)
+#define SWAPVECTOR(v) (SWAPFLOAT(v.x), SWAPFLOAT(v.y), SWAPFLOAT(v.z))
+#define SWAPVEC4(v) (SWAPFLOAT(v.x), SWAPFLOAT(v.y), SWAPFLOAT(v.z), SWAPFLOAT(v.w))
+
+/* everything in a compact surface is aligned to 4 bytes, so no two things start in the same slot */
+#define PHYS_SLOT_SIZE 4
+#define MAX_LEDGE_TRIANGLES SDL_MAX_SINT16
+
+/* reused for every compact surface a thread swaps */
+typedef struct phys_scratch {
+	Uint32 *swapped; /* one bit per slot of the compact surface, set once whatever starts there is swapped */
+	phys_compact_ledgetree_node_t **stack;
+	size_t max_depth;
+	Uint16 *point_indices; /* three per triangle of the ledge being swapped */
+} phys_scratch_t;
+
+/* a ledge can't have more triangles than fit in the compact surface */
+static size_t get_max_ledge_triangles(Sint64 max_size)
+{
+	return (size_t)SDL_min(max_size / (Sint64)sizeof(phys_compact_triangle_t), MAX_LEDGE_TRIANGLES);
+}
+
+/* each node pops one and pushes two the first time it's reached, so one over the number of nodes is always enough */
+static size_t get_max_ledgetree_depth(Sint64 max_size)
+{
+	return (size_t)(max_size / (Sint64)sizeof(phys_compact_ledgetree_node_t) + 1);
+}
+
+/* for compact surfaces up to max_size bytes */
+static size_t get_phys_scratch_size(Sint64 max_size)
+{
+	size_t num_words = (size_t)(max_size / PHYS_SLOT_SIZE / 32 + 1);
+	size_t num_indices = get_max_ledge_triangles(max_size) * 3;
+	size_t max_depth = get_max_ledgetree_depth(max_size);
+	return sizeof(phys_scratch_t) + num_words * sizeof(Uint32) + max_depth * sizeof(phys_compact_ledgetree_node_t *) + num_indices * sizeof(Uint16) + 64;
+}
+
+static phys_scratch_t *create_phys_scratch(arena_t *arena, Sint64 max_size)
+{
+	size_t num_words = (size_t)(max_size / PHYS_SLOT_SIZE / 32 + 1);
+	size_t num_indices = get_max_ledge_triangles(max_size) * 3;
+	phys_scratch_t *scratch = arena_alloc(arena, sizeof(phys_scratch_t));
+	if (!scratch)
+		return NULL;
+
+	scratch->swapped = arena_alloc(arena, num_words * sizeof(Uint32));
+	scratch->max_depth = get_max_ledgetree_depth(max_size);
+	scratch->stack = arena_alloc(arena, scratch->max_depth * sizeof(phys_compact_ledgetree_node_t *));
+	scratch->point_indices = arena_alloc(arena, num_indices * sizeof(Uint16));
+	if (!scratch->swapped || !scratch->stack || !scratch->point_indices)
+		return NULL;
+
+	return scratch;
+}
+
+static bool is_in_surface(const Uint8 *surface, Uint32 surface_size, const void *ptr, size_t size)
+{
+	return (const Uint8 *)ptr >= surface && size <= surface_size && (size_t)((const Uint8 *)ptr - surface) <= surface_size - size;
+}
+
+/* true the first time it's called for a slot */
+static bool mark_swapped(phys_scratch_t *scratch, const Uint8 *surface, const void *ptr)
+{
+	size_t slot = (size_t)((const Uint8 *)ptr - surface) / PHYS_SLOT_SIZE;
+	Uint32 bit = 1u << (slot % 32);
+
+	if (scratch->swapped[slot / 32] & bit)
+		return false;
+
+	scratch->swapped[slot / 32] |= bit;
+	return true;
+}
+
+static bool swap_compact_ledge(phys_compact_ledge_t *ledge, const Uint8 *surface, Uint32 surface_size, phys_scratch_t *scratch)
+{
+	SWAP32(ledge->ofs_point_array);
+	SWAP32(ledge->ofs_ledgetree_node);
+
+	Uint32 bitfield0 = ledge->bitfields << 24;
+	Uint32 bitfield00 = bitfield0 & 0x03000000;
+	Uint32 bitfield01 = bitfield0 & 0x0C000000;
+	Uint32 bitfield02 = bitfield0 & 0xF0000000;
+
+	ledge->bitfields = ((bitfield00 << 6) | (bitfield01 << 2) | (bitfield02 >> 4)) | (ledge->bitfields >> 8);
+
+	SWAP32(ledge->bitfields);
+
+	SWAP16(ledge->num_triangles);
+	SWAP16(ledge->reserved);
+
+	/* swap triangles and points */
+	vec4_t *points = (vec4_t *)((Uint8 *)ledge + ledge->ofs_point_array);
+	phys_compact_triangle_t *triangles = (phys_compact_triangle_t *)(ledge + 1);
+	if (ledge->num_triangles < 0 || !is_in_surface(surface, surface_size, triangles, ledge->num_triangles * sizeof(phys_compact_triangle_t)))
+		return false;
+
+	swap_compact_triangles(triangles, ledge->num_triangles, scratch->point_indices);
+
+	/* points are shared between triangles and ledges */
+	for (int i = 0; i < ledge->num_triangles * 3; i++)
+	{
+		Uint32 n = scratch->point_indices[i];
+		if (!is_in_surface(surface, surface_size, &points[n], sizeof(vec4_t)))
+			return false;
+
+		if (mark_swapped(scratch, surface, &points[n]))
+			SWAPVEC4(points[n]);
+	}
+
+	return true;
+}
+
+/* walk the whole tree without recursing, swapping every node and ledge once */
+static bool swap_ledgetree(phys_compact_surface_t *compact_surface, Uint32 surface_size, phys_scratch_t *scratch)
+{
+	const Uint8 *surface = (const Uint8 *)compact_surface;
+
+	/* only the slots this surface covers need clearing */
+	SDL_memset(scratch->swapped, 0, (surface_size / PHYS_SLOT_SIZE / 32 + 1) * sizeof(Uint32));
+
+	size_t depth = 0;
+	scratch->stack[depth++] = (phys_compact_ledgetree_node_t *)((Uint8 *)compact_surface + compact_surface->ofs_ledgetree_root);
+
+	while (depth > 0)
+	{
+		phys_compact_ledgetree_node_t *ltn = scratch->stack[--depth];
+
+		if (!is_in_surface(surface, surface_size, ltn, sizeof(phys_compact_ledgetree_node_t)))
+			return false;
+
+		if (!mark_swapped(scratch, surface, ltn))
+			continue;
+
+		SWAP32(ltn->ofs_right_node);
+		SWAP32(ltn->ofs_compact_ledge);
+		SWAPVECTOR(ltn->center);
+		SWAPFLOAT(ltn->radius);
+
+		/* has compact ledge */
+		if (ltn->ofs_compact_ledge != 0)
+		{
+			phys_compact_ledge_t *ledge = (phys_compact_ledge_t *)((Uint8 *)ltn + ltn->ofs_compact_ledge);
+			if (!is_in_surface(surface, surface_size, ledge, sizeof(phys_compact_ledge_t)))
+				return false;
+
+			if (mark_swapped(scratch, surface, ledge) && !swap_compact_ledge(ledge, surface, surface_size, scratch))
+				return false;
+		}
+
+		/* has children, the left one right after it and popped first */
+		if (ltn->ofs_right_node != 0)
+		{
+			/* only nodes overlapping each other can get it this deep */
+			if (depth + 2 > scratch->max_depth)
+				return false;
+
+			scratch->stack[depth++] = (phys_compact_ledgetree_node_t *)((Uint8 *)ltn + ltn->ofs_right_node);
+			scratch->stack[depth++] = ltn + 1;
+		}
+	}
+
+	return true;
+}
+
+/* where everything in the physics lump is, found without swapping anything */
+typedef struct phys_index {
+	int num_models;
+	Uint32 *model_offsets; /* including the one that ends the list */
+	int num_solids;
+	Uint32 *solid_offsets; /* of each solid's size */
+	Uint32 max_solid_size;
+} phys_index_t;
+
+static Sint32 get_s32be(const Uint8 *ptr)
+{
+	Uint32 value;
+	SDL_memcpy(&value, ptr, 4);
+	return (Sint32)SDL_Swap32BE(value);
+}
+
+/* walk the model headers and solid sizes, and fill in the index if it's been allocated */
+static bool scan_phys_lump(const Uint8 *data, Sint64 size, phys_index_t *index)
+{
+	Sint64 ofs = 0;
+	int num_models = 0;
+	int num_solids = 0;
+
+	/* ended by a model with a negative index, or the end of the lump */
+	while (size - ofs >= (Sint64)sizeof(phys_model_t))
+	{
+		const Uint8 *header = data + ofs;
+		Sint32 model_index = get_s32be(header + 0);
+		Sint32 len_data = get_s32be(header + 4);
+		Sint32 len_key_data = get_s32be(header + 8);
+		Sint32 num_model_solids = get_s32be(header + 12);
+
+		if (index->model_offsets)
+			index->model_offsets[num_models] = (Uint32)ofs;
+		num_models++;
+
+		if (model_index < 0 || len_data < 0)
+			break;
+
+		ofs += sizeof(phys_model_t);
+
+		for (int i = 0; i < num_model_solids; i++)
+		{
+			if (size - ofs < 4)
+				return false;
+
+			Uint32 solid_size = (Uint32)get_s32be(data + ofs);
+			if (solid_size < sizeof(phys_solid_t) || solid_size > size - ofs - 4)
+				return false;
+
+			if (index->solid_offsets)
+				index->solid_offsets[num_solids] = (Uint32)ofs;
+			num_solids++;
+
+			index->max_solid_size = SDL_max(index->max_solid_size, solid_size);
+			ofs += 4 + solid_size;
+		}
+
+		/* text data */
+		if (len_key_data < 0 || len_key_data > size - ofs)
+			return false;
+
+		ofs += len_key_data;
+	}
+
+	index->num_models = num_models;
+	index->num_solids = num_solids;
+
+	return true;
+}
+
+static bool index_phys_lump(arena_t *arena, const Uint8 *data, Sint64 size, phys_index_t *index)
+{
+	/* once to count them, then again to fill in where they are */
+	SDL_zerop(index);
+	if (!scan_phys_lump(data, size, index))
+		return false;
+
+	index->model_offsets = arena_alloc(arena, sizeof(Uint32) * SDL_max(index->num_models, 1));
+	index->solid_offsets = arena_alloc(arena, sizeof(Uint32) * SDL_max(index->num_solids, 1));
+	if (!index->model_offsets || !index->solid_offsets)
+		return false;
+
+	return scan_phys_lump(data, size, index);
+}
+
+static void swap_phys_models(Uint8 *data, const phys_index_t *index)
+{
+	for (int i = 0; i < index->num_models; i++)
+	{
+		phys_model_t *header = (phys_model_t *)(data + index->model_offsets[i]);
+
+		SWAP32(header->model_index);
+		SWAP32(header->len_data);
+		SWAP32(header->len_key_data);
+		SWAP32(header->num_solids);
+	}
+}
+
+/* a solid from its size onwards, which is all it touches */
+static bool swap_phys_solid(Uint8 *ptr, int i, phys_scratch_t *scratch)
+{
+	SWAP32(*(Uint32 *)ptr);
+	Uint32 size = *(Uint32 *)ptr;
+	ptr += 4;
+
+	phys_solid_t *solid = (phys_solid_t *)ptr;
+
+	SWAP32(solid->id);
+	SWAP16(solid->version);
+	SWAP16(solid->type);
+
+	/* sanity check */
+	if (solid->id != VPHYSICS_MAGIC)
+	{
+		log_warning("solid %d has incorrect magic value 0x%08x (should be 0x%08x)", i, solid->id, VPHYSICS_MAGIC);
+		return true;
+	}
+
+	/* sanity check */
+	if (solid->version != VPHYSICS_VERSION)
+	{
+		log_warning("solid %d has incorrect version value 0x%04x (should be 0x%04x)", i, solid->version, VPHYSICS_VERSION);
+		return true;
+	}
+
+	if (solid->type == 0) /* poly */
+	{
+		/* sanity check */
+		if (size < sizeof(phys_solid_t) + sizeof(phys_surface_t) + sizeof(phys_compact_surface_t))
+		{
+			log_warning("solid %d: too small for its compact surface", i);
+			return false;
+		}
+
+		/* swap nasty ivp shit */
+		phys_surface_t *surface = (phys_surface_t *)(ptr + sizeof(phys_solid_t));
+
+		SWAP32(surface->surface_size);
+		SWAPVECTOR(surface->axis);
+		SWAP32(surface->axis_size);
+
+		phys_compact_surface_t *compact_surface = (phys_compact_surface_t *)(surface + 1);
+
+		SWAPVECTOR(compact_surface->mass_center);
+		SWAPVECTOR(compact_surface->rotation_inertia);
+		SWAPFLOAT(compact_surface->upper_limit_radius);
+
+		Uint8 max_factor_surface_deviation = compact_surface->bitfields & 0xFF;
+		Uint32 byte_size = (compact_surface->bitfields & 0xFFFFFF00);
+
+		SWAP32(byte_size);
+
+		compact_surface->bitfields = byte_size << 8 | max_factor_surface_deviation;
+
+		SWAP32(compact_surface->ofs_ledgetree_root);
+
+		/* sanity check */
+		if (surface->surface_size < 0 || (Uint32)surface->surface_size != byte_size)
+		{
+			log_warning("solid %d: size mismatch", i);
+			return false;
+		}
+
+		/* sanity check */
+		if ((Uint8 *)compact_surface + byte_size > ptr + size)
+		{
+			log_warning("solid %d: compact surface is past the end of the solid", i);
+			return false;
+		}
+
+		/* swap the ledgetree, and every ledge hanging off it */
+		if (!swap_ledgetree(compact_surface, byte_size, scratch))
+		{
+			log_warning("solid %d: ledgetree failed to validate", i);
+			return false;
+		}
+	}
+	else if (solid->type == 1) /* mopp */
+	{
+		log_warning("solid %d: COLLIDE_MOPP unsupported", i);
+		return false;
+	}
+	else if (solid->type == 2) /* ball */
+	{
+		log_warning("solid %d: COLLIDE_BALL unsupported", i);
+		return false;
+	}
+	else if (solid->type == 3) /* virtual */
+	{
+		log_warning("solid %d: COLLIDE_VIRTUAL unsupported", i);
+		return false;
+	}
+	else /* unknown */
+	{
+		log_warning("solid %d: unknown type %d", i, solid->type);
+		return false;
+	}
+
+	return true;
+}
+
+#define DETAIL_PROP_LIGHTSTYLE_SIZE 5
+#define PROP_NAME_SIZE 128
+
+#define FOURCC_ARGS(x) (char)((x) >> 24), (char)((x) >> 16), (char)((x) >> 8), (char)(x)
+
+static const struct_schema_t *static_prop_schemas[] = {
+	&static_prop_v4_schema,
+	&static_prop_v5_schema,
+	&static_prop_v6_schema,
+	&static_prop_v7_schema,
+	&static_prop_v8_schema,
+	&static_prop_v9_schema,
+	&static_prop_v10_schema,
+	&static_prop_v11_schema
+};
+
+/* swap the count in front of an array, returning how many bytes the two take or -1 if they don't fit */
+static Sint64 swap_counted_array(Uint8 *ptr, Sint64 size_left, size_t element_size, Sint32 *count)
+{
+	if (size_left < 4)
+		return -1;
+
+	/* not always aligned, since the arrays before it can be any length */
+	Uint32 value;
+	SDL_memcpy(&value, ptr, 4);
+	SWAP32(value);
+	SDL_memcpy(ptr, &value, 4);
+	*count = (Sint32)value;
+
+	if (*count < 0 || (Sint64)*count * (Sint64)element_size > size_left - 4)
+		return -1;
+
+	return 4 + (Sint64)*count * (Sint64)element_size;
+}
+
+static bool swap_static_props(int version, void *data, Sint64 size)
+{
+	Uint8 *ptr = (Uint8 *)data;
+	Sint64 used;
+	Sint32 count;
+
+	if (version < 4 || version > 11)
+	{
+		log_warning("Static props version %d unsupported", version);
+		return false;
+	}
+
+	const struct_schema_t *schema = static_prop_schemas[version - 4];
+
+	/* model names */
+	if ((used = swap_counted_array(ptr, size, PROP_NAME_SIZE, &count)) < 0)
+		return false;
+	ptr += used;
+	size -= used;
+
+	/* leaves */
+	if ((used = swap_counted_array(ptr, size, sizeof(Uint16), &count)) < 0)
+		return false;
+	swap16_array(ptr + 4, count);
+	ptr += used;
+	size -= used;
+
+	/* props */
+	if ((used = swap_counted_array(ptr, size, schema->size, &count)) < 0)
+		return false;
+	swap_structs(schema, ptr + 4, count);
+
+	return true;
+}
+
+static bool swap_detail_props(int version, void *data, Sint64 size)
+{
+	Uint8 *ptr = (Uint8 *)data;
+	Sint64 used;
+	Sint32 count;
+
+	if (version != 4)
+	{
+		log_warning("Detail props version %d unsupported", version);
+		return false;
+	}
+
+	/* model names */
+	if ((used = swap_counted_array(ptr, size, PROP_NAME_SIZE, &count)) < 0)
+		return false;
+	ptr += used;
+	size -= used;
+
+	/* sprites */
+	if ((used = swap_counted_array(ptr, size, detail_sprite_schema.size, &count)) < 0)
+		return false;
+	swap_structs(&detail_sprite_schema, ptr + 4, count);
+	ptr += used;
+	size -= used;
+
+	/* objects */
+	if ((used = swap_counted_array(ptr, size, detail_object_schema.size, &count)) < 0)
+		return false;
+	swap_structs(&detail_object_schema, ptr + 4, count);
+
+	return true;
+}
+
+bool swap_bsp_game_lump(Uint32 id, int version, void *data, Sint64 size)
+{
+	Sint32 count;
+
+	switch (id)
+	{
+		case GAME_LUMP_STATIC_PROPS:
+			return swap_static_props(version, data, size);
+
+		case GAME_LUMP_DETAIL_PROPS:
+			return swap_detail_props(version, data, size);
+
+		/* colors and styles are all bytes */
+		case GAME_LUMP_DETAIL_PROP_LIGHTING:
+		case GAME_LUMP_DETAIL_PROP_LIGHTING_HDR:
+			return swap_counted_array((Uint8 *)data, size, DETAIL_PROP_LIGHTSTYLE_SIZE, &count) >= 0;
+
+		default:
+			return false;
+	}
+}
+
+bool swap_bsp_lump(arena_t *arena, int lump, int lump_version, void *lump_data, Sint64 lump_size)
+{
+	switch (lump)
+	{
+		/* byte-sized data */
+		case 0: /* entities */
+		case 8: /* ldr lighting samples */
+		case 34: /* displacement lightmap sample positions */
+		case 43: /* texdata string data */
+		case 53: /* hdr lighting samples */
+		case 55: /* hdr ambient lighting samples  */
+		case 56: /* ldr ambient lighting samples */
+		{
+			return true;
+		}
+
+		/* short-sized data */
+		case 11: /* face ids */
+		case 12: /* edges */
+		case 16: /* leaf faces */
+		case 17: /* leaf brushes */
+		case 19: /* brush sides */
+		case 31: /* vertex normal indices */
+		case 39: /* primitive vertex indices */
+		case 46: /* leaf distances to water */
+		case 47: /* face macro texture info */
+		case 48: /* displacement triangles */
+		case 51: /* index of hdr lighting samples */
+		case 52: /* index of ldr lighting samples */
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(Uint16));
+
+			swap16_array(lump_data, lump_size / sizeof(Uint16));
+
+			return true;
+		}
+
+		/* int-sized data */
+		case 1: /* planes */
+		case 2: /* texdata */
+		case 3: /* vertices */
+		case 6: /* texinfos */
+		case 13: /* surfedges */
+		case 14: /* models */
+		case 15: /* ldr world lights */
+		case 18: /* brushes */
+		case 20: /* areas */
+		case 30: /* vertex normals */
+		case 33: /* displacement vertices */
+		case 38: /* primitive vertices */
+		case 41: /* clip portal vertices */
+		case 42: /* cubemaps */
+		case 44: /* texdata string table */
+		case 54: /* hdr world lights */
+		case 59: /* map flags */
+		case 60: /* overlay fade distances */
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(Uint32));
+
+			swap32_array(lump_data, lump_size / sizeof(Uint32));
+
+			return true;
+		}
+
+		/* visibility */
+		case 4:
+		{
+			if (lump_size < 4)
+				return false;
+
+			/* the cluster count has to fit, since the lump is swapped in place next to others */
+			Uint32 *vis = (Uint32 *)lump_data;
+			SWAP32(vis[0]);
+			if (vis[0] > (Uint64)(lump_size - 4) / 8)
+				return false;
+
+			swap32_array(vis + 1, vis[0] * 2);
+			return true;
+		}
+
+		/* nodes */
+		case 5:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(node_t));
+
+			swap_structs(&node_schema, lump_data, lump_size / sizeof(node_t));
+
+			return true;
+		}
+
+		/* occlusion lump */
+		case 9:
+		{
+			Uint8 *ptr = (Uint8 *)lump_data;
+			Uint8 *end = ptr + lump_size;
+			size_t occluder_size = lump_version >= 1 ? 40 : 36;
+
+			/* every count is checked against what's left before anything after it is touched */
+			if (end - ptr < 4)
+				return false;
+
+			Uint32 *count = (Uint32 *)ptr;
+			SWAP32(*count);
+			ptr += 4;
+
+			if (*count > (size_t)(end - ptr) / occluder_size)
+				return false;
+
+			for (Uint32 i = 0; i < *count; i++)
+			{
+				occluder_data_t *occluder_data = (occluder_data_t *)ptr;
+
+				SWAP32(occluder_data[0].flags);
+				SWAP32(occluder_data[0].first_poly);
+				SWAP32(occluder_data[0].num_polys);
+
+				SWAPVECTOR(occluder_data[0].mins);
+				SWAPVECTOR(occluder_data[0].maxs);
+
+				if (lump_version >= 1)
+					SWAP32(occluder_data[0].area);
+
+				ptr += occluder_size;
+			}
+
+			if (end - ptr < 4)
+				return false;
+
+			count = (Uint32 *)ptr;
+			SWAP32(*count);
+			ptr += 4;
+
+			if (*count > (size_t)(end - ptr) / sizeof(occluder_poly_data_t))
+				return false;
+
+			/* occluder_poly_data_t is all ints */
+			swap32_array(ptr, *count * (sizeof(occluder_poly_data_t) / sizeof(Uint32)));
+			ptr += *count * sizeof(occluder_poly_data_t);
+
+			if (end - ptr < 4)
+				return false;
+
+			count = (Uint32 *)ptr;
+			SWAP32(*count);
+			ptr += 4;
+
+			if (*count > (size_t)(end - ptr) / sizeof(Uint32))
+				return false;
+
+			swap32_array(ptr, *count);
+
+			return true;
+		}
+
+		/* leafs */
+		case 10:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(leaf_t));
+
+			swap_structs(&leaf_schema, lump_data, lump_size / sizeof(leaf_t));
+
+			return true;
+		}
+
+		/* faces (ldr and hdr) */
+		case 7:
+		case 27:
+		case 58:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(face_t));
+
+			swap_structs(&face_schema, lump_data, lump_size / sizeof(face_t));
+
+			return true;
+		}
+
+		/* areaportals */
+		case 21:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(areaportal_t));
+
+			swap_structs(&areaportal_schema, lump_data, lump_size / sizeof(areaportal_t));
+
+			return true;
+		}
+
+		/* disp info */
+		case 26:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(disp_info_t));
+
+			swap_structs(&disp_info_schema, lump_data, lump_size / sizeof(disp_info_t));
+
+			return true;
+		}
+
+		/* phys disp */
+		case 28:
+		{
+			if (lump_size < 2)
+				return false;
+
+			Uint16 *ptr = (Uint16 *)lump_data;
+			SWAP16(ptr[0]);
+			if (ptr[0] > (lump_size - 2) / 2)
+				return false;
+
+			swap16_array(ptr + 1, ptr[0]);
+			return true;
+		}
+
+		/* phys models */
+		case 29:
+		{
+			phys_index_t index;
+			if (!index_phys_lump(arena, lump_data, lump_size, &index))
+				return false;
+
+			phys_scratch_t *scratch = create_phys_scratch(arena, index.max_solid_size);
+			if (!scratch)
+				return false;
+
+			for (int i = 0; i < index.num_solids; i++)
+				if (!swap_phys_solid((Uint8 *)lump_data + index.solid_offsets[i], i, scratch))
+					return false;
+
+			swap_phys_models(lump_data, &index);
+
+			return true;
+		}
+
+		/* game lumps, when they couldn't be converted one by one */
+		case 35:
+		{
+			/* HACKHACK */
+			Uint32 *temp = (Uint32 *)lump_data;
+			*temp = 0;
+			return true;
+		}
+
+		/* leaf water data */
+		case 36:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(leaf_water_data_t));
+
+			swap_structs(&leaf_water_data_schema, lump_data, lump_size / sizeof(leaf_water_data_t));
+
+			return true;
+		}
+
+		/* primtiives */
+		case 37:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(primitive_t));
+
+			swap_structs(&primitive_schema, lump_data, lump_size / sizeof(primitive_t));
+
+			return true;
+		}
+
+		/* pakfile, when it couldn't be read as a zip */
+		case 40:
+		{
+			return false;
+		}
+
+		/* overlays */
+		case 45:
+		{
+			CHECK_FUNNY_LUMP_SIZE(sizeof(overlay_t));
+
+			swap_structs(&overlay_schema, lump_data, lump_size / sizeof(overlay_t));
+
+			return true;
+		}
+
+		/* unknown lump */
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+#undef SWAPVECTOR
+#undef SWAPFLOAT
+#undef SWAP32
+#undef SWAP16
+#undef CHECK_FUNNY_LUMP_SIZE
+
+size_t get_bsp_lump_element_size(int lump)
+{
+	switch (lump)
+	{
+		case 0: case 8: case 34: case 43: case 53: case 55: case 56:
+			return 1;
+
+		case 11: case 12: case 16: case 17: case 19: case 31: case 39:
+		case 46: case 47: case 48: case 51: case 52:
+			return sizeof(Uint16);
+
+		case 1: case 2: case 3: case 6: case 13: case 14: case 15: case 18:
+		case 20: case 30: case 33: case 38: case 41: case 42: case 44:
+		case 54: case 59: case 60:
+			return sizeof(Uint32);
+
+		case 5: return sizeof(node_t);
+		case 7: case 27: case 58: return sizeof(face_t);
+		case 10: return sizeof(leaf_t);
+		case 21: return sizeof(areaportal_t);
+		case 26: return sizeof(disp_info_t);
+		case 36: return sizeof(leaf_water_data_t);
+		case 37: return sizeof(primitive_t);
+		case 45: return sizeof(overlay_t);
+
+		default: return 0;
+	}
+}
+
+bool read_bsp_header(const void *data, size_t size, bsp_header_t *header)
+{
+	if (size < sizeof(bsp_header_t))
+		return false;
+
+	/* the header is nothing but big endian ints, so swap it all in one go */
+	SDL_memcpy(header, data, sizeof(bsp_header_t));
+	swap32_array(header, sizeof(bsp_header_t) / sizeof(Uint32));
+
+	return header->magic == BSP_MAGIC && header->version == BSP_VERSION;
+}
+
+static void write_bsp_lump(SDL_IOStream *io, bsp_lump_t *lump)
+{
+	SDL_WriteU32LE(io, lump->offset);
+	SDL_WriteU32LE(io, lump->length);
+	SDL_WriteU32LE(io, lump->version);
+	SDL_WriteU32LE(io, lump->identifier);
+}
+
+static void write_bsp_header(SDL_IOStream *io, bsp_header_t *header)
+{
+	SDL_WriteU32LE(io, header->magic);
+	SDL_WriteU32LE(io, header->version);
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+		write_bsp_lump(io, &header->lumps[lump]);
+	SDL_WriteU32LE(io, header->map_version);
+}
+
+typedef enum lump_status {
+	LUMP_STATUS_EMPTY,
+	LUMP_STATUS_OK,
+	LUMP_STATUS_SKIPPED,
+	LUMP_STATUS_ERROR
+} lump_status_t;
+
+typedef struct lump_job {
+	lump_status_t status;
+} lump_job_t;
+
+#define MAX_GAME_LUMPS 64
+#define GAME_LUMP_ENTRY_SIZE 16
+
+typedef struct game_lump {
+	Uint32 id;
+	Uint16 flags;
+	Uint16 version;
+	Uint32 offset;
+	Uint32 length;
+	bool compressed;
+	Uint32 output_offset; /* from the start of the game lump */
+	Uint32 output_length;
+	lump_status_t status;
+} game_lump_t;
+
+typedef struct lump_order {
+	int lump;
+	Sint64 size;
+} lump_order_t;
+
+typedef struct bsp_conversion {
+	Uint8 *input;
+	size_t input_size;
+	bsp_header_t *header;
+	bsp_header_t *output_header;
+	output_file_t *output;
+	arena_t *arena;
+	void **windows;
+	lump_job_t jobs[BSP_NUM_LUMPS];
+	bool has_game_lumps;
+	int num_game_lumps;
+	Sint64 game_lumps_size;
+	game_lump_t game_lumps[MAX_GAME_LUMPS];
+	SDL_IOStream *pakfile_io;
+	zip360_t *pakfile;
+	Uint8 *physics;
+	Sint64 physics_size;
+	phys_index_t physics_index;
+	phys_scratch_t **phys_scratch;
+	SDL_AtomicInt phys_failed;
+} bsp_conversion_t;
+
+typedef struct lump_window {
+	bsp_conversion_t *conversion;
+	int lump;
+	int version;
+	Sint64 offset;
+	Uint64 span; /* decoding the next window */
+	perf_sample_t sample;
+	bool swap_failed; /* stopped on bad data rather than an I/O or decode error */
+} lump_window_t;
+
+static bool read_game_lump_directory(const Uint8 *input, size_t input_size, const bsp_lump_t *info, game_lump_t *game_lumps, int *num_game_lumps, Sint64 *size)
+{
+	/* a game lump that's compressed as a whole has no directory to read */
+	if (info->identifier > 0 || info->length < 4 || (Uint64)info->offset + info->length > input_size)
+		return false;
+
+	const Uint8 *ptr = input + info->offset;
+	Uint32 count;
+	SDL_memcpy(&count, ptr, 4);
+	count = SDL_Swap32BE(count);
+	ptr += 4;
+
+	if (count > MAX_GAME_LUMPS || 4 + (Uint64)count * GAME_LUMP_ENTRY_SIZE > info->length)
+	{
+		log_warning("Game lump directory with %u entries unsupported", count);
+		return false;
+	}
+
+	/* sub-lumps go right after the directory, decompressed */
+	*size = 4 + count * GAME_LUMP_ENTRY_SIZE;
+	for (Uint32 i = 0; i < count; i++, ptr += GAME_LUMP_ENTRY_SIZE)
+	{
+		game_lump_t *game_lump = &game_lumps[i];
+		SDL_zerop(game_lump);
+
+		SDL_memcpy(&game_lump->id, ptr, 4);
+		SDL_memcpy(&game_lump->flags, ptr + 4, 2);
+		SDL_memcpy(&game_lump->version, ptr + 6, 2);
+		SDL_memcpy(&game_lump->offset, ptr + 8, 4);
+		SDL_memcpy(&game_lump->length, ptr + 12, 4);
+
+		game_lump->id = SDL_Swap32BE(game_lump->id);
+		game_lump->flags = SDL_Swap16BE(game_lump->flags);
+		game_lump->version = SDL_Swap16BE(game_lump->version);
+		game_lump->offset = SDL_Swap32BE(game_lump->offset);
+		game_lump->length = SDL_Swap32BE(game_lump->length);
+
+		if (game_lump->length == 0)
+			continue;
+
+		/* offsets are from the start of the file */
+		if ((Uint64)game_lump->offset + game_lump->length > input_size)
+		{
+			log_warning("Game lump \"%c%c%c%c\": Data is past the end of the file", FOURCC_ARGS(game_lump->id));
+			return false;
+		}
+
+		Sint64 uncompressed_size = get_lzma_uncompressed_size(input + game_lump->offset, game_lump->length);
+		game_lump->compressed = uncompressed_size >= 0;
+		game_lump->output_offset = *size;
+		game_lump->output_length = game_lump->compressed ? uncompressed_size : game_lump->length;
+
+		*size += game_lump->output_length;
+	}
+
+	*num_game_lumps = count;
+	return true;
+}
+
+static bool write_game_lump_directory(bsp_conversion_t *conversion)
+{
+	Uint32 base = conversion->output_header->lumps[BSP_GAME_LUMP].offset;
+	size_t size = 4 + conversion->num_game_lumps * GAME_LUMP_ENTRY_SIZE;
+	void *data = arena_alloc(conversion->arena, size);
+	if (!data)
+		return false;
+
+	SDL_IOStream *io = SDL_IOFromMem(data, size);
+	SDL_WriteU32LE(io, conversion->num_game_lumps);
+	for (int i = 0; i < conversion->num_game_lumps; i++)
+	{
+		game_lump_t *game_lump = &conversion->game_lumps[i];
+		bool ok = game_lump->status == LUMP_STATUS_OK;
+
+		SDL_WriteU32LE(io, game_lump->id);
+		SDL_WriteU16LE(io, game_lump->compressed ? game_lump->flags & ~GAME_LUMP_FLAG_COMPRESSED : game_lump->flags);
+		SDL_WriteU16LE(io, game_lump->version);
+		SDL_WriteU32LE(io, ok ? base + game_lump->output_offset : 0);
+		SDL_WriteU32LE(io, ok ? game_lump->output_length : 0);
+	}
+	SDL_CloseIO(io);
+
+	return write_output_file(conversion->output, base, data, size);
+}
+
+static void open_pakfile(bsp_conversion_t *conversion, const bsp_lump_t *info, int num_threads)
+{
+	if (info->length == 0 || (Uint64)info->offset + info->length > conversion->input_size)
+		return;
+
+	void *data = conversion->input + info->offset;
+	size_t size = info->length;
+
+	/* the zip's size changes, so it has to be decompressed before anything can be laid out */
+	if (info->identifier > 0)
+	{
+		void *uncompressed = arena_alloc(conversion->arena, info->identifier);
+		if (!uncompressed)
+			return;
+
+		Uint64 span = begin_trace_span();
+		perf_sample_t sample;
+		begin_perf_sample(&sample);
+		bool ok = decompress_lzma_buffer(data, info->length, uncompressed, info->identifier);
+		end_perf_sample(&sample, "decompress", info->identifier, "lump %d", BSP_PAKFILE_LUMP);
+		end_trace_span(span, "decompress", info->length, info->identifier, "lump %d", BSP_PAKFILE_LUMP);
+		if (!ok)
+			return;
+
+		data = uncompressed;
+		size = info->identifier;
+	}
+
+	conversion->pakfile_io = SDL_IOFromConstMem(data, size);
+	if (!conversion->pakfile_io)
+		return;
+
+	/* anything compressed inside it comes out stored */
+	conversion->pakfile = open_zip360(conversion->pakfile_io, conversion->arena, "pakfile");
+	if (conversion->pakfile && !decompress_zip360(conversion->pakfile, num_threads, false))
+		conversion->pakfile = NULL;
+
+	/* lump lengths are 32-bit, even if the zip isn't */
+	if (conversion->pakfile && get_zip360_output_size(conversion->pakfile) > SDL_MAX_UINT32)
+	{
+		log_warning("Lump %d: Pakfile is too big to convert", BSP_PAKFILE_LUMP);
+		conversion->pakfile = NULL;
+	}
+
+	if (!conversion->pakfile)
+	{
+		log_warning("Lump %d: Failed to read pakfile", BSP_PAKFILE_LUMP);
+		SDL_CloseIO(conversion->pakfile_io);
+		conversion->pakfile_io = NULL;
+	}
+}
+
+/* find the physics lump's solids up front, so they can be swapped as separate jobs */
+static void open_physics(bsp_conversion_t *conversion, const bsp_lump_t *info, int num_threads)
+{
+	if (info->length == 0 || (Uint64)info->offset + info->length > conversion->input_size)
+		return;
+
+	Uint8 *data = conversion->input + info->offset;
+	Sint64 size = info->length;
+
+	if (info->identifier > 0)
+	{
+		Uint8 *uncompressed = arena_alloc(conversion->arena, info->identifier);
+		if (!uncompressed)
+			return;
+
+		Uint64 span = begin_trace_span();
+		perf_sample_t sample;
+		begin_perf_sample(&sample);
+		bool ok = decompress_lzma_buffer(data, info->length, uncompressed, info->identifier);
+		end_perf_sample(&sample, "decompress", info->identifier, "lump %d", BSP_PHYSICS_LUMP);
+		end_trace_span(span, "decompress", info->length, info->identifier, "lump %d", BSP_PHYSICS_LUMP);
+		if (!ok)
+			return;
+
+		data = uncompressed;
+		size = info->identifier;
+	}
+
+	/* anything wrong with it gets reported when it's converted as a whole instead */
+	if (!index_phys_lump(conversion->arena, data, size, &conversion->physics_index))
+	{
+		SDL_zero(conversion->physics_index);
+		return;
+	}
+
+	conversion->physics = data;
+	conversion->physics_size = size;
+	conversion->phys_scratch = arena_calloc(conversion->arena, num_threads, sizeof(phys_scratch_t *));
+	if (!conversion->phys_scratch)
+	{
+		SDL_zero(conversion->physics_index);
+		return;
+	}
+
+	SDL_SetAtomicInt(&conversion->phys_failed, 0);
+}
+
+static void convert_phys_solid(bsp_conversion_t *conversion, int index, int thread)
+{
+	/* no point in carrying on */
+	if (SDL_GetAtomicInt(&conversion->phys_failed))
+		return;
+
+	/* each thread keeps its scratch space for every solid it gets */
+	if (!conversion->phys_scratch[thread])
+		conversion->phys_scratch[thread] = create_phys_scratch(conversion->arena, conversion->physics_index.max_solid_size);
+
+	if (!conversion->phys_scratch[thread])
+	{
+		SDL_SetAtomicInt(&conversion->phys_failed, 1);
+		return;
+	}
+
+	Uint8 *solid = conversion->physics + conversion->physics_index.solid_offsets[index];
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	if (!swap_phys_solid(solid, index, conversion->phys_scratch[thread]))
+		SDL_SetAtomicInt(&conversion->phys_failed, 1);
+	end_perf_sample(&sample, "swap", 4 + (Uint32)get_s32be(solid), "physics solids");
+	end_trace_span(span, "swap", 4 + (Uint32)get_s32be(solid), -1, "solid %d", index);
+}
+
+/* the model headers are swapped and the whole lump is written once every solid is done */
+static lump_status_t finish_physics(bsp_conversion_t *conversion)
+{
+	if (SDL_GetAtomicInt(&conversion->phys_failed))
+	{
+		log_warning("Lump %d: Failed to byteswap data", BSP_PHYSICS_LUMP);
+		return LUMP_STATUS_SKIPPED;
+	}
+
+	swap_phys_models(conversion->physics, &conversion->physics_index);
+
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	bool ok = write_output_file(conversion->output, conversion->output_header->lumps[BSP_PHYSICS_LUMP].offset, conversion->physics, conversion->physics_size);
+	end_perf_sample(&sample, "write", conversion->physics_size, "lump %d", BSP_PHYSICS_LUMP);
+	end_trace_span(span, "write", -1, conversion->physics_size, "lump %d", BSP_PHYSICS_LUMP);
+
+	if (!ok)
+	{
+		log_warning("Lump %d: Failed to write data", BSP_PHYSICS_LUMP);
+		return LUMP_STATUS_ERROR;
+	}
+
+	return LUMP_STATUS_OK;
+}
+
+static int compare_lump_order(const void *a, const void *b)
+{
+	const lump_order_t *left = (const lump_order_t *)a;
+	const lump_order_t *right = (const lump_order_t *)b;
+
+	/* biggest first, ties broken by lump index so the order is stable */
+	if (left->size != right->size)
+		return left->size > right->size ? -1 : 1;
+	return left->lump - right->lump;
+}
+
+#define LUMP_WINDOW_SIZE (256 * 1024)
+
+static bool convert_lump_window(void *data, size_t size, Sint64 offset, void *userdata)
+{
+	lump_window_t *window = (lump_window_t *)userdata;
+	end_perf_sample(&window->sample, "decompress", size, "lump %d", window->lump);
+	end_trace_span(window->span, "decompress", -1, size, "lump %d", window->lump);
+
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	bool ok = swap_bsp_lump(window->conversion->arena, window->lump, window->version, data, size);
+	end_perf_sample(&sample, "swap", size, "lump %d", window->lump);
+	end_trace_span(span, "swap", size, size, "lump %d", window->lump);
+
+	if (!ok)
+	{
+		log_warning("Lump %d: Failed to byteswap data", window->lump);
+		window->swap_failed = true;
+		return false;
+	}
+
+	span = begin_trace_span();
+	begin_perf_sample(&sample);
+	ok = write_output_file(window->conversion->output, window->offset + offset, data, size);
+	end_perf_sample(&sample, "write", size, "lump %d", window->lump);
+	end_trace_span(span, "write", -1, size, "lump %d", window->lump);
+
+	if (!ok)
+	{
+		log_warning("Lump %d: Failed to write data", window->lump);
+		return false;
+	}
+
+	window->span = begin_trace_span();
+	begin_perf_sample(&window->sample);
+
+	return true;
+}
+
+static void convert_lump(void *userdata, int lump, int thread)
+{
+	bsp_conversion_t *conversion = (bsp_conversion_t *)userdata;
+	bsp_lump_t *info = &conversion->header->lumps[lump];
+	bsp_lump_t *output_info = &conversion->output_header->lumps[lump];
+	lump_job_t *job = &conversion->jobs[lump];
+
+	/* the pakfile was already read as a zip, so it only needs writing, on this thread alongside the other lumps */
+	if (lump == BSP_PAKFILE_LUMP && conversion->pakfile)
+	{
+		if (!write_zip360(conversion->pakfile, conversion->output, output_info->offset, 1))
+		{
+			log_warning("Lump %d: Failed to convert pakfile", lump);
+			job->status = LUMP_STATUS_SKIPPED;
+			return;
+		}
+
+		job->status = LUMP_STATUS_OK;
+		return;
+	}
+
+	/* sanity check */
+	if ((Uint64)info->offset + info->length > conversion->input_size)
+	{
+		log_warning("Lump %d: Data is past the end of the file", lump);
+		job->status = LUMP_STATUS_ERROR;
+		return;
+	}
+
+	/* the input is a private mapping, so uncompressed lumps get swapped right where they are */
+	void *lump_data = conversion->input + info->offset;
+	Sint64 lump_size = info->length;
+
+	/* they use the identifier to show that its compressed... for some reason */
+	if (info->identifier > 0)
+	{
+		/* decompress lzma stuff straight out of the mapping */
+		Sint64 uncompressed_size = get_lzma_uncompressed_size(lump_data, info->length);
+		if (uncompressed_size < 0)
+		{
+			log_warning("Lump %d: Failed to decompress", lump);
+			job->status = LUMP_STATUS_ERROR;
+			return;
+		}
+		else if (info->identifier != uncompressed_size)
+		{
+			log_warning("Lump %d: Uncompressed size mismatch %u != %d", lump, info->identifier, (int)uncompressed_size);
+			job->status = LUMP_STATUS_ERROR;
+			return;
+		}
+
+		/* flat lumps get swapped and written a window at a time, while it's still in cache */
+		size_t element_size = get_bsp_lump_element_size(lump);
+		if (element_size > 0 && uncompressed_size % element_size == 0)
+		{
+			/* each thread keeps its window for every lump it gets */
+			if (!conversion->windows[thread])
+				conversion->windows[thread] = arena_alloc(conversion->arena, LUMP_WINDOW_SIZE);
+
+			if (!conversion->windows[thread])
+			{
+				job->status = LUMP_STATUS_ERROR;
+				return;
+			}
+
+			lump_window_t window;
+			SDL_zero(window);
+			window.conversion = conversion;
+			window.lump = lump;
+			window.version = info->version;
+			window.offset = output_info->offset;
+			window.span = begin_trace_span();
+			begin_perf_sample(&window.sample);
+			bool ok = decompress_lzma_window(lump_data, info->length, conversion->windows[thread], LUMP_WINDOW_SIZE, element_size, convert_lump_window, &window);
+
+			if (ok)
+				job->status = LUMP_STATUS_OK;
+			else
+				job->status = window.swap_failed ? LUMP_STATUS_SKIPPED : LUMP_STATUS_ERROR;
+			return;
+		}
+
+		void *uncompressed = arena_alloc(conversion->arena, uncompressed_size);
+		if (!uncompressed)
+		{
+			job->status = LUMP_STATUS_ERROR;
+			return;
+		}
+
+		Uint64 span = begin_trace_span();
+		perf_sample_t sample;
+		begin_perf_sample(&sample);
+		bool ok = decompress_lzma_buffer(lump_data, info->length, uncompressed, uncompressed_size);
+		end_perf_sample(&sample, "decompress", uncompressed_size, "lump %d", lump);
+		end_trace_span(span, "decompress", info->length, uncompressed_size, "lump %d", lump);
+
+		if (!ok)
+		{
+			log_warning("Lump %d: Failed to decompress", lump);
+			job->status = LUMP_STATUS_ERROR;
+			return;
+		}
+
+		lump_data = uncompressed;
+		lump_size = uncompressed_size;
+	}
+
+	/* byteswap data */
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	bool ok = swap_bsp_lump(conversion->arena, lump, info->version, lump_data, lump_size);
+	end_perf_sample(&sample, "swap", lump_size, "lump %d", lump);
+	end_trace_span(span, "swap", lump_size, lump_size, "lump %d", lump);
+
+	if (!ok)
+	{
+		log_warning("Lump %d: Failed to byteswap data", lump);
+		job->status = LUMP_STATUS_SKIPPED;
+		return;
+	}
+
+	/* write it straight to its slot in the output */
+	span = begin_trace_span();
+	begin_perf_sample(&sample);
+	ok = write_output_file(conversion->output, output_info->offset, lump_data, lump_size);
+	end_perf_sample(&sample, "write", lump_size, "lump %d", lump);
+	end_trace_span(span, "write", -1, lump_size, "lump %d", lump);
+
+	if (!ok)
+	{
+		log_warning("Lump %d: Failed to write data", lump);
+		job->status = LUMP_STATUS_ERROR;
+		return;
+	}
+
+	job->status = LUMP_STATUS_OK;
+}
+
+static void convert_game_lump(bsp_conversion_t *conversion, int index)
+{
+	game_lump_t *game_lump = &conversion->game_lumps[index];
+	void *data = conversion->input + game_lump->offset;
+	Sint64 size = game_lump->length;
+
+	/* each one is compressed on its own */
+	if (game_lump->compressed)
+	{
+		void *uncompressed = arena_alloc(conversion->arena, game_lump->output_length);
+		if (!uncompressed)
+		{
+			game_lump->status = LUMP_STATUS_ERROR;
+			return;
+		}
+
+		Uint64 span = begin_trace_span();
+		perf_sample_t sample;
+		begin_perf_sample(&sample);
+		bool ok = decompress_lzma_buffer(data, game_lump->length, uncompressed, game_lump->output_length);
+		end_perf_sample(&sample, "decompress", game_lump->output_length, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+		end_trace_span(span, "decompress", game_lump->length, game_lump->output_length, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+
+		if (!ok)
+		{
+			log_warning("Game lump \"%c%c%c%c\": Failed to decompress", FOURCC_ARGS(game_lump->id));
+			game_lump->status = LUMP_STATUS_ERROR;
+			return;
+		}
+
+		data = uncompressed;
+		size = game_lump->output_length;
+	}
+
+	/* byteswap data */
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	bool ok = swap_bsp_game_lump(game_lump->id, game_lump->version, data, size);
+	end_perf_sample(&sample, "swap", size, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+	end_trace_span(span, "swap", size, size, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+
+	if (!ok)
+	{
+		log_warning("Game lump \"%c%c%c%c\": Failed to byteswap data", FOURCC_ARGS(game_lump->id));
+		game_lump->status = LUMP_STATUS_SKIPPED;
+		return;
+	}
+
+	/* write it straight to its slot in the output */
+	Uint32 offset = conversion->output_header->lumps[BSP_GAME_LUMP].offset + game_lump->output_offset;
+	span = begin_trace_span();
+	begin_perf_sample(&sample);
+	ok = write_output_file(conversion->output, offset, data, size);
+	end_perf_sample(&sample, "write", size, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+	end_trace_span(span, "write", -1, size, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+
+	if (!ok)
+	{
+		log_warning("Game lump \"%c%c%c%c\": Failed to write data", FOURCC_ARGS(game_lump->id));
+		game_lump->status = LUMP_STATUS_ERROR;
+		return;
+	}
+
+	game_lump->status = LUMP_STATUS_OK;
+}
+
+/* jobs past the last lump are game lumps, and past those are physics solids */
+static void convert_job(void *userdata, int job, int thread)
+{
+	bsp_conversion_t *conversion = (bsp_conversion_t *)userdata;
+	Uint64 span = begin_trace_span();
+
+	if (job < BSP_NUM_LUMPS)
+	{
+		convert_lump(userdata, job, thread);
+		end_trace_span(span, "convert", conversion->header->lumps[job].length, conversion->output_header->lumps[job].length, "lump %d", job);
+	}
+	else if (job < BSP_NUM_LUMPS + MAX_GAME_LUMPS)
+	{
+		game_lump_t *game_lump = &conversion->game_lumps[job - BSP_NUM_LUMPS];
+		convert_game_lump(conversion, job - BSP_NUM_LUMPS);
+		end_trace_span(span, "convert", game_lump->length, game_lump->output_length, "game lump %c%c%c%c", FOURCC_ARGS(game_lump->id));
+	}
+	else
+	{
+		convert_phys_solid(conversion, job - BSP_NUM_LUMPS - MAX_GAME_LUMPS, thread);
+	}
+}
+
+/* everything a conversion allocates, besides the input mapping */
+static size_t get_bsp_arena_size(const bsp_header_t *header, const game_lump_t *game_lumps, int num_game_lumps, int num_threads)
+{
+	size_t size = num_threads * sizeof(void *);
+	bool windowed = false;
+
+	size += 4 + num_game_lumps * GAME_LUMP_ENTRY_SIZE + 16;
+	for (int i = 0; i < num_game_lumps; i++)
+		if (game_lumps[i].compressed)
+			size += game_lumps[i].output_length + 16;
+
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+	{
+		const bsp_lump_t *info = &header->lumps[lump];
+		size_t element_size = get_bsp_lump_element_size(lump);
+
+		if (info->identifier == 0)
+			continue;
+		else if (element_size > 0 && info->identifier % element_size == 0)
+			windowed = true;
+		else
+			size += info->identifier + 16;
+	}
+
+	if (windowed)
+		size += num_threads * LUMP_WINDOW_SIZE;
+
+	/* the pakfile's central dir is read into memory, its entries are copied straight across */
+	size += header->lumps[BSP_PAKFILE_LUMP].length / 16;
+
+	/* the physics lump's index and each thread's scratch space, which can't be any bigger than the lump */
+	const bsp_lump_t *physics = &header->lumps[BSP_PHYSICS_LUMP];
+	Sint64 physics_size = physics->identifier > 0 ? physics->identifier : physics->length;
+	size += physics_size / 16 + num_threads * get_phys_scratch_size(physics_size);
+
+	return size;
+}
+
+Sint64 estimate_bsp360_memory(const char *filename, int num_threads)
+{
+	/* mapped, since the game lump directory points all over the file */
+	size_t input_size;
+	Uint8 *input = map_file(filename, &input_size);
+	if (!input)
+		return -1;
+
+	bsp_header_t inputHeader;
+	if (!read_bsp_header(input, input_size, &inputHeader))
+	{
+		unmap_file(input, input_size);
+		return -1;
+	}
+
+	game_lump_t game_lumps[MAX_GAME_LUMPS];
+	int num_game_lumps = 0;
+	Sint64 game_lumps_size;
+	if (!read_game_lump_directory(input, input_size, &inputHeader.lumps[BSP_GAME_LUMP], game_lumps, &num_game_lumps, &game_lumps_size))
+		num_game_lumps = 0;
+
+	unmap_file(input, input_size);
+
+	/* uncompressed lumps dirty the private mapping, compressed ones come out of the arena */
+	Sint64 total = sizeof(bsp_header_t) + get_bsp_arena_size(&inputHeader, game_lumps, num_game_lumps, num_threads);
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+		if (inputHeader.lumps[lump].identifier == 0)
+			total += inputHeader.lumps[lump].length;
+
+	return total;
+}
+
+bool convert_bsp360(const char *filename, const char *output_filename, int num_threads)
+{
+	bool saved = false;
+
+	bsp_conversion_t conversion;
+	SDL_zero(conversion);
+
+	/* map input file */
+	set_memory_stage("read");
+	conversion.input = map_file(filename, &conversion.input_size);
+	if (!conversion.input)
+	{
+		log_warning("Failed to open \"%s\" for reading", filename);
+		goto cleanup;
+	}
+
+	/* read input header */
+	bsp_header_t inputHeader;
+	if (conversion.input_size < sizeof(bsp_header_t))
+	{
+		log_warning("\"%s\" is too small to be a map", filename);
+		goto cleanup;
+	}
+
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	bool valid = read_bsp_header(conversion.input, conversion.input_size, &inputHeader);
+	end_perf_sample(&sample, "read header", sizeof(bsp_header_t), "map");
+	end_trace_span(span, "read header", sizeof(bsp_header_t), -1, "%s", filename);
+
+	if (!valid)
+	{
+		log_warning("\"%s\" has incorrect magic value or version", filename);
+		goto cleanup;
+	}
+
+	/* game lumps get converted one by one if the directory can be read */
+	conversion.has_game_lumps = read_game_lump_directory(conversion.input, conversion.input_size, &inputHeader.lumps[BSP_GAME_LUMP],
+		conversion.game_lumps, &conversion.num_game_lumps, &conversion.game_lumps_size);
+
+	/* one arena for everything this file needs, released in one go at the end */
+	set_memory_stage("arena");
+	conversion.arena = create_arena(get_bsp_arena_size(&inputHeader, conversion.game_lumps, conversion.num_game_lumps, num_threads));
+	if (!conversion.arena)
+	{
+		log_warning("Failed to create arena for \"%s\"", filename);
+		goto cleanup;
+	}
+
+	conversion.windows = arena_calloc(conversion.arena, num_threads, sizeof(void *));
+	if (!conversion.windows)
+		goto cleanup;
+
+	/* the pakfile gets converted as a zip, if it can be read as one */
+	set_memory_stage("pakfile");
+	open_pakfile(&conversion, &inputHeader.lumps[BSP_PAKFILE_LUMP], num_threads);
+
+	/* and the physics lump gets split up into its solids, if they can be found */
+	set_memory_stage("physics");
+	open_physics(&conversion, &inputHeader.lumps[BSP_PHYSICS_LUMP], num_threads);
+
+	/* lay out the output up front, in lump order, so every lump knows where it goes */
+	set_memory_stage("convert");
+	bsp_header_t outputHeader = inputHeader;
+	int max_jobs = BSP_NUM_LUMPS + MAX_GAME_LUMPS + conversion.physics_index.num_solids;
+	lump_order_t *order = arena_alloc(conversion.arena, sizeof(lump_order_t) * max_jobs);
+	if (!order)
+		goto cleanup;
+
+	int num_jobs = 0;
+	Sint64 outputSize = sizeof(bsp_header_t);
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+	{
+		if (lump == BSP_GAME_LUMP && conversion.has_game_lumps)
+			order[num_jobs].size = conversion.game_lumps_size;
+		else if (lump == BSP_PAKFILE_LUMP && conversion.pakfile)
+			order[num_jobs].size = get_zip360_output_size(conversion.pakfile);
+		else if (inputHeader.lumps[lump].identifier > 0)
+			order[num_jobs].size = inputHeader.lumps[lump].identifier;
+		else if (inputHeader.lumps[lump].length > 0)
+			order[num_jobs].size = inputHeader.lumps[lump].length;
+		else
+			continue;
+
+		outputHeader.lumps[lump].offset = outputSize;
+		outputHeader.lumps[lump].length = order[num_jobs].size;
+		outputSize += order[num_jobs].size;
+
+		/* the game lump's own data and the physics lump's solids get converted as separate jobs */
+		if ((lump == BSP_GAME_LUMP && conversion.has_game_lumps) || (lump == BSP_PHYSICS_LUMP && conversion.physics))
+			continue;
+
+		order[num_jobs++].lump = lump;
+	}
+
+	for (int i = 0; i < conversion.num_game_lumps; i++)
+	{
+		if (conversion.game_lumps[i].output_length > 0)
+		{
+			order[num_jobs].lump = BSP_NUM_LUMPS + i;
+			order[num_jobs++].size = conversion.game_lumps[i].output_length;
+		}
+	}
+
+	for (int i = 0; i < conversion.physics_index.num_solids; i++)
+	{
+		order[num_jobs].lump = BSP_NUM_LUMPS + MAX_GAME_LUMPS + i;
+		order[num_jobs++].size = 4 + (Uint32)get_s32be(conversion.physics + conversion.physics_index.solid_offsets[i]);
+	}
+
+	if (outputSize > SDL_MAX_UINT32)
+	{
+		log_warning("\"%s\" is too big to convert", filename);
+		goto cleanup;
+	}
+
+	/* open output file at its final size */
+	conversion.output = open_output_file(output_filename, outputSize);
+	if (!conversion.output)
+		goto cleanup;
+
+	/* schedule the biggest lumps first so they don't hold up the end of the conversion */
+	SDL_qsort(order, num_jobs, sizeof(lump_order_t), compare_lump_order);
+
+	int *job_order = arena_alloc(conversion.arena, sizeof(int) * max_jobs);
+	if (!job_order)
+		goto cleanup;
+
+	for (int i = 0; i < num_jobs; i++)
+		job_order[i] = order[i].lump;
+
+	/* decompress, byteswap and write all lumps */
+	conversion.header = &inputHeader;
+	conversion.output_header = &outputHeader;
+	run_jobs(num_jobs, num_threads, job_order, convert_job, &conversion);
+
+	if (conversion.physics)
+		conversion.jobs[BSP_PHYSICS_LUMP].status = finish_physics(&conversion);
+
+	/* bail if any lump couldn't be read or written */
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+		if (conversion.jobs[lump].status == LUMP_STATUS_ERROR)
+			goto cleanup;
+
+	for (int i = 0; i < conversion.num_game_lumps; i++)
+		if (conversion.game_lumps[i].status == LUMP_STATUS_ERROR)
+			goto cleanup;
+
+	/* the game lump directory can only be written once its entries know how they went */
+	if (conversion.has_game_lumps)
+	{
+		span = begin_trace_span();
+		bool ok = write_game_lump_directory(&conversion);
+		end_trace_span(span, "write", -1, 4 + conversion.num_game_lumps * GAME_LUMP_ENTRY_SIZE, "lump %d directory", BSP_GAME_LUMP);
+
+		if (!ok)
+		{
+			log_warning("Lump %d: Failed to write data", BSP_GAME_LUMP);
+			goto cleanup;
+		}
+
+		conversion.jobs[BSP_GAME_LUMP].status = LUMP_STATUS_OK;
+	}
+
+	/* skipped lumps leave a zeroed hole behind, which nothing points to */
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+	{
+		if (conversion.jobs[lump].status == LUMP_STATUS_SKIPPED)
+		{
+			outputHeader.lumps[lump].offset = 0;
+			outputHeader.lumps[lump].length = 0;
+		}
+	}
+
+	/* write output header last */
+	set_memory_stage("save");
+	span = begin_trace_span();
+	begin_perf_sample(&sample);
+	Uint8 headerData[sizeof(bsp_header_t)];
+	SDL_IOStream *headerIo = SDL_IOFromMem(headerData, sizeof(headerData));
+	write_bsp_header(headerIo, &outputHeader);
+	SDL_CloseIO(headerIo);
+
+	if (!write_output_file(conversion.output, 0, headerData, sizeof(headerData)))
+	{
+		log_warning("Failed to write \"%s\"", output_filename);
+		goto cleanup;
+	}
+
+	/* move output file into place */
+	saved = commit_output_file(conversion.output);
+	conversion.output = NULL;
+	end_perf_sample(&sample, "save", outputSize, "map");
+	end_trace_span(span, "save", -1, outputSize, "%s", output_filename);
+
+	if (!saved)
+		log_warning("Failed to save \"%s\"", output_filename);
+
+	/* clean up */
+cleanup:
+	if (conversion.output) discard_output_file(conversion.output);
+	if (conversion.pakfile_io) SDL_CloseIO(conversion.pakfile_io);
+	if (conversion.arena) destroy_arena(conversion.arena);
+	if (conversion.input) unmap_file(conversion.input, conversion.input_size);
+
+	return saved;
+}
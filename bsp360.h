@@ -0,0 +1,130 @@
+
+#ifndef _BSP360_H_
+#define _BSP360_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+#include "arena.h"
+
+#define BSP_MAGIC 0x50534256
+#define BSP_VERSION 20
+#define BSP_NUM_LUMPS 64
+#define BSP_PHYSICS_LUMP 29
+#define BSP_GAME_LUMP 35
+#define BSP_PAKFILE_LUMP 40
+
+#define VPHYSICS_MAGIC 0x59485056
+#define VPHYSICS_VERSION 0x100
+
+#define GAME_LUMP_STATIC_PROPS 0x73707270 /* sprp */
+#define GAME_LUMP_DETAIL_PROPS 0x64707270 /* dprp */
+#define GAME_LUMP_DETAIL_PROP_LIGHTING 0x64706c74 /* dplt */
+#define GAME_LUMP_DETAIL_PROP_LIGHTING_HDR 0x64706c68 /* dplh */
+
+#define GAME_LUMP_FLAG_COMPRESSED 0x0001
+
+typedef struct bsp_lump {
+	Uint32 offset;
+	Uint32 length;
+	Uint32 version;
+	Uint32 identifier;
+} bsp_lump_t;
+
+typedef struct bsp_header {
+	Uint32 magic;
+	Uint32 version;
+	bsp_lump_t lumps[BSP_NUM_LUMPS];
+	Uint32 map_version;
+} bsp_header_t;
+
+/**
+ * \brief read and byteswap the header of an Xbox 360 map
+ *
+ * \param data the start of the map
+ * \param size size of the map
+ * \param header pointer to fill with the swapped header
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true if it's a version 20 map, false otherwise
+ */
+bool read_bsp_header(const void *data, size_t size, bsp_header_t *header);
+
+/**
+ * \brief get the size of the elements in a lump that's nothing but an array of them
+ *
+ * \param lump index of the lump
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the element size, or 0 if the lump has any other layout
+ */
+size_t get_bsp_lump_element_size(int lump);
+
+/**
+ * \brief byteswap the uncompressed data of a lump in place
+ *
+ * \param arena arena for any scratch space the lump needs
+ * \param lump index of the lump
+ * \param lump_version version of the lump, from the header
+ * \param lump_data the lump data
+ * \param lump_size size of the lump data
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false if the lump is unsupported or invalid
+ *
+ * \note the game lump's directory and the pakfile aren't handled here, since
+ * converting them means moving data around
+ */
+bool swap_bsp_lump(arena_t *arena, int lump, int lump_version, void *lump_data, Sint64 lump_size);
+
+/**
+ * \brief byteswap the uncompressed data of a game lump in place
+ *
+ * \param id fourcc of the game lump
+ * \param version version of the game lump, from its directory entry
+ * \param data the game lump data
+ * \param size size of the game lump data
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false if the game lump is unsupported or invalid
+ */
+bool swap_bsp_game_lump(Uint32 id, int version, void *data, Sint64 size);
+
+/**
+ * \brief estimate the memory needed to convert a map
+ *
+ * \param filename name of the map
+ * \param num_threads number of threads the map will be converted on
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the estimated number of bytes, or -1 on error
+ */
+Sint64 estimate_bsp360_memory(const char *filename, int num_threads);
+
+/**
+ * \brief convert an Xbox 360 map to PC
+ *
+ * \param filename name of the map
+ * \param output_filename name of the converted map
+ * \param num_threads decompress and byteswap lumps on this many threads
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true if the converted map was saved, false on error
+ *
+ * \note lumps that can't be converted are left out of the converted map,
+ * with a warning
+ */
+bool convert_bsp360(const char *filename, const char *output_filename, int num_threads);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _BSP360_H_ */
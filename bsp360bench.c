@@ -0,0 +1,404 @@
+#include <SDL3/SDL.h>
+
+#include "arena.h"
+#include "bsp360.h"
+#include "decompress_lzma.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#define HEADER_REPEATS 10000
+#define GAME_LUMP_ENTRY_SIZE 16
+
+typedef struct bench_options {
+	int iterations;
+	int num_threads;
+} bench_options_t;
+
+/* every stage keeps its fastest run */
+typedef struct bench_stage {
+	Uint64 start;
+	Uint64 best;
+} bench_stage_t;
+
+/* the fastest runs of every lump and game lump that's compressed, added up */
+typedef struct bench_lzma {
+	Uint64 total;
+	Sint64 bytes;
+} bench_lzma_t;
+
+static void start_stage(bench_stage_t *stage)
+{
+	stage->start = SDL_GetPerformanceCounter();
+}
+
+static void stop_stage(bench_stage_t *stage)
+{
+	Uint64 elapsed = SDL_GetPerformanceCounter() - stage->start;
+	if (stage->best == 0 || elapsed < stage->best)
+		stage->best = SDL_max(elapsed, 1);
+}
+
+static void report_stage(const char *name, const bench_stage_t *stage, Sint64 bytes, Sint64 elements)
+{
+	double seconds = (double)stage->best / SDL_GetPerformanceFrequency();
+	double megabytes = bytes / (1024.0 * 1024.0);
+
+	if (elements > 0)
+		log_info("  %-20s %10.3f MB %10.1f MB/s %14.0f elements/s", name, megabytes, megabytes / seconds, elements / seconds);
+	else
+		log_info("  %-20s %10.3f MB %10.1f MB/s", name, megabytes, megabytes / seconds);
+}
+
+static Uint32 get_u32be(const Uint8 *ptr)
+{
+	Uint32 value;
+	SDL_memcpy(&value, ptr, 4);
+	return SDL_Swap32BE(value);
+}
+
+static Uint16 get_u16be(const Uint8 *ptr)
+{
+	Uint16 value;
+	SDL_memcpy(&value, ptr, 2);
+	return SDL_Swap16BE(value);
+}
+
+/* how many things a lump holds, read from its data before it's swapped */
+static Sint64 count_lump_elements(int lump, const Uint8 *data, Sint64 size)
+{
+	size_t element_size = get_bsp_lump_element_size(lump);
+	if (element_size > 0)
+		return size / element_size;
+
+	switch (lump)
+	{
+		/* clusters and occluders */
+		case 4:
+		case 9:
+			return size >= 4 ? get_u32be(data) : 0;
+
+		/* displacements */
+		case 28:
+			return size >= 2 ? get_u16be(data) : 0;
+
+		/* solids, from each model's header */
+		case BSP_PHYSICS_LUMP:
+		{
+			Sint64 count = 0;
+			Sint64 ofs = 0;
+			while (size - ofs >= 16)
+			{
+				Sint32 model_index = (Sint32)get_u32be(data + ofs);
+				Sint32 len_data = (Sint32)get_u32be(data + ofs + 4);
+				Sint32 len_key_data = (Sint32)get_u32be(data + ofs + 8);
+				if (model_index < 0 || len_data < 0 || len_key_data < 0)
+					break;
+
+				count += (Sint32)get_u32be(data + ofs + 12);
+				ofs += 16 + (Sint64)len_data + len_key_data;
+			}
+			return count;
+		}
+
+		default:
+			return 0;
+	}
+}
+
+/* decompress a lump or game lump once per iteration, keeping the last result */
+static void *bench_decompress(const Uint8 *data, Sint64 size, Sint64 uncompressed_size, int iterations, bench_lzma_t *lzma)
+{
+	void *uncompressed = SDL_malloc(uncompressed_size);
+	bench_stage_t stage;
+	SDL_zero(stage);
+
+	for (int i = 0; i < iterations; i++)
+	{
+		start_stage(&stage);
+		bool ok = decompress_lzma_buffer(data, size, uncompressed, uncompressed_size);
+		stop_stage(&stage);
+
+		if (!ok)
+		{
+			SDL_free(uncompressed);
+			return NULL;
+		}
+	}
+
+	lzma->total += stage.best;
+	lzma->bytes += uncompressed_size;
+
+	return uncompressed;
+}
+
+static void bench_lumps(const Uint8 *input, size_t input_size, const bsp_header_t *header, const bench_options_t *options, bench_lzma_t *lzma)
+{
+	/* everything the lumps allocate while being swapped, which only gets bigger */
+	arena_t *arena = create_arena(0);
+	if (!arena)
+	{
+		log_warning("Failed to create arena for swapping lumps");
+		return;
+	}
+
+	for (int lump = 0; lump < BSP_NUM_LUMPS; lump++)
+	{
+		const bsp_lump_t *info = &header->lumps[lump];
+
+		/* the game lump's directory and the pakfile aren't swapped as lumps */
+		if (info->length == 0 || lump == BSP_GAME_LUMP || lump == BSP_PAKFILE_LUMP)
+			continue;
+
+		if ((Uint64)info->offset + info->length > input_size)
+		{
+			log_warning("Lump %d: Data is past the end of the file", lump);
+			continue;
+		}
+
+		const Uint8 *data = input + info->offset;
+		Sint64 size = info->length;
+
+		void *uncompressed = NULL;
+		if (info->identifier > 0)
+		{
+			uncompressed = bench_decompress(data, size, info->identifier, options->iterations, lzma);
+			if (!uncompressed)
+			{
+				log_warning("Lump %d: Failed to decompress", lump);
+				continue;
+			}
+
+			data = uncompressed;
+			size = info->identifier;
+		}
+
+		/* byte lumps are written as they are, so there's no swap to time */
+		if (get_bsp_lump_element_size(lump) == 1)
+		{
+			SDL_free(uncompressed);
+			continue;
+		}
+
+		/* a fresh copy every time, since swapping is done in place */
+		void *work = SDL_malloc(size);
+		bench_stage_t swap;
+		bool ok = true;
+		SDL_zero(swap);
+
+		for (int i = 0; i < options->iterations && ok; i++)
+		{
+			SDL_memcpy(work, data, size);
+
+			start_stage(&swap);
+			ok = swap_bsp_lump(arena, lump, info->version, work, size);
+			stop_stage(&swap);
+		}
+
+		char name[32];
+		SDL_snprintf(name, sizeof(name), "swap lump %d", lump);
+
+		if (ok)
+			report_stage(name, &swap, size, count_lump_elements(lump, data, size));
+		else
+			log_warning("  %-20s failed", name);
+
+		SDL_free(work);
+		SDL_free(uncompressed);
+	}
+
+	destroy_arena(arena);
+}
+
+static void bench_game_lumps(const Uint8 *input, size_t input_size, const bsp_header_t *header, const bench_options_t *options, bench_lzma_t *lzma)
+{
+	const bsp_lump_t *info = &header->lumps[BSP_GAME_LUMP];
+
+	/* a game lump that's compressed as a whole has no directory to read */
+	if (info->identifier > 0 || info->length < 4 || (Uint64)info->offset + info->length > input_size)
+		return;
+
+	const Uint8 *ptr = input + info->offset;
+	Uint32 count = get_u32be(ptr);
+	if (4 + (Uint64)count * GAME_LUMP_ENTRY_SIZE > info->length)
+		return;
+
+	for (Uint32 i = 0; i < count; i++)
+	{
+		const Uint8 *entry = ptr + 4 + i * GAME_LUMP_ENTRY_SIZE;
+		Uint32 id = get_u32be(entry);
+		Uint16 version = get_u16be(entry + 6);
+		Uint32 offset = get_u32be(entry + 8);
+		Uint32 length = get_u32be(entry + 12);
+
+		if (length == 0 || (Uint64)offset + length > input_size)
+			continue;
+
+		const Uint8 *data = input + offset;
+		Sint64 size = length;
+
+		void *uncompressed = NULL;
+		Sint64 uncompressed_size = get_lzma_uncompressed_size(data, length);
+		if (uncompressed_size >= 0)
+		{
+			uncompressed = bench_decompress(data, size, uncompressed_size, options->iterations, lzma);
+			if (!uncompressed)
+			{
+				log_warning("Game lump \"%c%c%c%c\": Failed to decompress", (char)(id >> 24), (char)(id >> 16), (char)(id >> 8), (char)id);
+				continue;
+			}
+
+			data = uncompressed;
+			size = uncompressed_size;
+		}
+
+		void *work = SDL_malloc(size);
+		bench_stage_t swap;
+		bool ok = true;
+		SDL_zero(swap);
+
+		for (int j = 0; j < options->iterations && ok; j++)
+		{
+			SDL_memcpy(work, data, size);
+
+			start_stage(&swap);
+			ok = swap_bsp_game_lump(id, version, work, size);
+			stop_stage(&swap);
+		}
+
+		char name[32];
+		SDL_snprintf(name, sizeof(name), "swap game lump %c%c%c%c", (char)(id >> 24), (char)(id >> 16), (char)(id >> 8), (char)id);
+
+		if (ok)
+			report_stage(name, &swap, size, 0);
+		else
+			log_warning("  %-20s failed", name);
+
+		SDL_free(work);
+		SDL_free(uncompressed);
+	}
+}
+
+static void bench_bsp(const char *filename, const bench_options_t *options)
+{
+	log_info("Benchmarking \"%s\", best of %d", filename, options->iterations);
+
+	size_t input_size;
+	Uint8 *input = map_file(filename, &input_size);
+	if (!input)
+	{
+		log_warning("Failed to open \"%s\" for reading", filename);
+		return;
+	}
+
+	/* the header is tiny, so it's read over and over to get a measurable time */
+	bsp_header_t header;
+	bench_stage_t read_header;
+	bool valid = true;
+	SDL_zero(read_header);
+
+	for (int i = 0; i < options->iterations; i++)
+	{
+		start_stage(&read_header);
+		for (int j = 0; j < HEADER_REPEATS; j++)
+			valid = read_bsp_header(input, input_size, &header);
+		stop_stage(&read_header);
+	}
+
+	if (!valid)
+	{
+		log_warning("\"%s\" has incorrect magic value or version", filename);
+		unmap_file(input, input_size);
+		return;
+	}
+
+	report_stage("read header", &read_header, (Sint64)sizeof(bsp_header_t) * HEADER_REPEATS, HEADER_REPEATS);
+
+	bench_lzma_t lzma;
+	SDL_zero(lzma);
+
+	bench_lumps(input, input_size, &header, options, &lzma);
+	bench_game_lumps(input, input_size, &header, options, &lzma);
+
+	if (lzma.bytes > 0)
+	{
+		bench_stage_t decode = {0, lzma.total};
+		report_stage("lzma decode", &decode, lzma.bytes, 0);
+	}
+
+	unmap_file(input, input_size);
+
+	/* the whole conversion, written next to the input and thrown away */
+	char outputFilename[1024];
+	SDL_snprintf(outputFilename, sizeof(outputFilename), "%s.bench", filename);
+
+	bench_stage_t convert;
+	bool ok = true;
+	SDL_zero(convert);
+
+	for (int i = 0; i < options->iterations && ok; i++)
+	{
+		start_stage(&convert);
+		ok = convert_bsp360(filename, outputFilename, options->num_threads);
+		stop_stage(&convert);
+	}
+
+	SDL_RemovePath(outputFilename);
+
+	if (ok)
+		report_stage("convert", &convert, input_size, 0);
+	else
+		log_warning("  %-20s failed", "convert");
+}
+
+static void print_usage(void)
+{
+	log_info("Usage: bsp360bench [-i iterations] [-j threads] file.360.bsp ...");
+	log_info("  -i iterations  run every stage this many times and keep the fastest (default 5)");
+	log_info("  -j threads     convert on this many threads (0 = one per core)");
+}
+
+int main(int argc, char **argv)
+{
+	bench_options_t options;
+	options.iterations = 5;
+	options.num_threads = 1;
+
+	int num_files = 0;
+	char **filenames = SDL_malloc(sizeof(char *) * argc);
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (SDL_strcmp(argv[arg], "-i") == 0 || SDL_strcmp(argv[arg], "-j") == 0)
+		{
+			if (arg + 1 >= argc)
+			{
+				print_usage();
+				num_files = 0;
+				break;
+			}
+
+			if (argv[arg][1] == 'i')
+				options.iterations = SDL_max(SDL_atoi(argv[arg + 1]), 1);
+			else
+				options.num_threads = get_num_workers(SDL_atoi(argv[arg + 1]));
+
+			arg++;
+			continue;
+		}
+
+		filenames[num_files++] = argv[arg];
+	}
+
+	for (int i = 0; i < num_files; i++)
+		bench_bsp(filenames[i], &options);
+
+	free_lzma_pool();
+	free_arena_cache();
+
+	SDL_free(filenames);
+
+	SDL_Quit();
+
+	return 0;
+}
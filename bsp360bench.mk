@@ -0,0 +1,30 @@
+
+RM?=rm -f
+PKGCONFIG?=pkg-config
+PKGS?=sdl3
+
+override CFLAGS+=$(shell $(PKGCONFIG) --cflags $(PKGS)) -g3
+override LDFLAGS+=$(shell $(PKGCONFIG) --libs $(PKGS)) -llzma
+
+BINEXT?=
+OBJEXT?=.o
+
+EXEC?=bsp360bench$(BINEXT)
+OBJS=bsp360bench$(OBJEXT) arena$(OBJEXT) bsp360$(OBJEXT) byteswap$(OBJEXT) decompress_lzma$(OBJEXT) mapped_file$(OBJEXT) memory_tracker$(OBJEXT) output_file$(OBJEXT) perf_counters$(OBJEXT) thread_pool$(OBJEXT) trace$(OBJEXT) utils$(OBJEXT) zip360$(OBJEXT)
+
+BENCH_MAP?=bench.360.bsp
+BENCH_MEGABYTES?=64
+
+all: $(EXEC)
+
+clean:
+	$(RM) $(EXEC) $(OBJS)
+
+$(EXEC): $(OBJS)
+	$(CC) -o $@ $^ $(LDFLAGS)
+
+# generate a compressed map and benchmark every stage of converting it
+bench: $(EXEC)
+	$(MAKE) -f bsp360gen.mk
+	./bsp360gen$(BINEXT) -z -s $(BENCH_MEGABYTES) $(BENCH_MAP)
+	./$(EXEC) $(BENCH_MAP)
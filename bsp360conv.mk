@@ -2,6 +2,7 @@
 RM?=rm -f
 PKGCONFIG?=pkg-config
 PKGS?=sdl3
+PYTHON?=python3
 
 override CFLAGS+=$(shell $(PKGCONFIG) --cflags $(PKGS)) -g3
 override LDFLAGS+=$(shell $(PKGCONFIG) --libs $(PKGS)) -llzma
@@ -10,7 +11,7 @@ BINEXT?=
 OBJEXT?=.o
 
 EXEC?=bsp360conv$(BINEXT)
-OBJS=bsp360conv$(OBJEXT) decompress_lzma$(OBJEXT) utils$(OBJEXT)
+OBJS=bsp360conv$(OBJEXT) arena$(OBJEXT) batch$(OBJEXT) bsp360$(OBJEXT) byteswap$(OBJEXT) decompress_lzma$(OBJEXT) mapped_file$(OBJEXT) memory_tracker$(OBJEXT) output_file$(OBJEXT) perf_counters$(OBJEXT) thread_pool$(OBJEXT) trace$(OBJEXT) utils$(OBJEXT) zip360$(OBJEXT)
 
 all: $(EXEC)
 
@@ -19,3 +20,7 @@ clean:
 
 $(EXEC): $(OBJS)
 	$(CC) -o $@ $^ $(LDFLAGS)
+
+# regenerate the struct swap schemas after changing kaitai/bsp360.ksy
+schemas:
+	$(PYTHON) python/gen_lump_schemas.py kaitai/bsp360.ksy lump_schemas.h
@@ -0,0 +1,781 @@
+#include <SDL3/SDL.h>
+
+#include "bsp360.h"
+#include "decompress_lzma.h"
+#include "lump_schemas.h"
+#include "utils.h"
+
+#define PROP_NAME_SIZE 128
+#define DETAIL_PROP_LIGHTSTYLE_SIZE 5
+#define OCCLUDER_SIZE 40 /* version 1, with an area */
+#define OCCLUDER_POLY_SIZE 12
+#define COMPACT_SURFACE_SIZE 48
+#define LEDGETREE_NODE_SIZE 28
+#define MAX_LEDGES_PER_SOLID 64
+
+typedef enum gen_kind {
+	GEN_BYTES,
+	GEN_TEXT,
+	GEN_SHORTS,
+	GEN_INTS,
+	GEN_FLOATS,
+	GEN_VISIBILITY,
+	GEN_OCCLUSION,
+	GEN_PHYS_DISP,
+	GEN_PHYSICS,
+	GEN_GAME_LUMP
+} gen_kind_t;
+
+typedef struct gen_lump {
+	int lump;
+	gen_kind_t kind;
+	int weight; /* share of the map, in tenths of a percent */
+	const struct_schema_t *schema;
+} gen_lump_t;
+
+/* every lump the converter can swap, weighted roughly like a real map */
+static const gen_lump_t gen_lumps[] = {
+	{0, GEN_TEXT, 40, NULL}, /* entities */
+	{1, GEN_FLOATS, 20, NULL}, /* planes */
+	{2, GEN_INTS, 1, NULL}, /* texdata */
+	{3, GEN_FLOATS, 30, NULL}, /* vertices */
+	{4, GEN_VISIBILITY, 60, NULL},
+	{5, GEN_INTS, 20, &node_schema},
+	{6, GEN_FLOATS, 10, NULL}, /* texinfos */
+	{7, GEN_INTS, 40, &face_schema},
+	{8, GEN_BYTES, 120, NULL}, /* ldr lighting samples */
+	{9, GEN_OCCLUSION, 2, NULL},
+	{10, GEN_INTS, 20, &leaf_schema},
+	{11, GEN_SHORTS, 5, NULL}, /* face ids */
+	{12, GEN_SHORTS, 20, NULL}, /* edges */
+	{13, GEN_INTS, 20, NULL}, /* surfedges */
+	{14, GEN_FLOATS, 1, NULL}, /* models */
+	{15, GEN_FLOATS, 1, NULL}, /* ldr world lights */
+	{16, GEN_SHORTS, 10, NULL}, /* leaf faces */
+	{17, GEN_SHORTS, 10, NULL}, /* leaf brushes */
+	{18, GEN_INTS, 10, NULL}, /* brushes */
+	{19, GEN_SHORTS, 10, NULL}, /* brush sides */
+	{20, GEN_INTS, 1, NULL}, /* areas */
+	{21, GEN_INTS, 1, &areaportal_schema},
+	{26, GEN_FLOATS, 10, &disp_info_schema},
+	{27, GEN_INTS, 20, &face_schema}, /* original faces */
+	{28, GEN_PHYS_DISP, 10, NULL},
+	{29, GEN_PHYSICS, 150, NULL},
+	{30, GEN_FLOATS, 30, NULL}, /* vertex normals */
+	{31, GEN_SHORTS, 10, NULL}, /* vertex normal indices */
+	{33, GEN_FLOATS, 30, NULL}, /* displacement vertices */
+	{34, GEN_BYTES, 20, NULL}, /* displacement lightmap sample positions */
+	{35, GEN_GAME_LUMP, 60, NULL},
+	{36, GEN_FLOATS, 1, &leaf_water_data_schema},
+	{37, GEN_INTS, 1, &primitive_schema},
+	{38, GEN_FLOATS, 1, NULL}, /* primitive vertices */
+	{39, GEN_SHORTS, 1, NULL}, /* primitive vertex indices */
+	{41, GEN_FLOATS, 1, NULL}, /* clip portal vertices */
+	{42, GEN_INTS, 1, NULL}, /* cubemaps */
+	{43, GEN_TEXT, 2, NULL}, /* texdata string data */
+	{44, GEN_INTS, 1, NULL}, /* texdata string table */
+	{45, GEN_FLOATS, 5, &overlay_schema},
+	{46, GEN_SHORTS, 5, NULL}, /* leaf distances to water */
+	{47, GEN_SHORTS, 5, NULL}, /* face macro texture info */
+	{48, GEN_SHORTS, 10, NULL}, /* displacement triangles */
+	{51, GEN_SHORTS, 2, NULL}, /* index of hdr lighting samples */
+	{52, GEN_SHORTS, 2, NULL}, /* index of ldr lighting samples */
+	{53, GEN_BYTES, 120, NULL}, /* hdr lighting samples */
+	{54, GEN_FLOATS, 1, NULL}, /* hdr world lights */
+	{55, GEN_BYTES, 5, NULL}, /* hdr ambient lighting samples */
+	{56, GEN_BYTES, 5, NULL}, /* ldr ambient lighting samples */
+	{58, GEN_INTS, 20, &face_schema}, /* hdr faces */
+	{59, GEN_INTS, 0, NULL}, /* map flags */
+	{60, GEN_FLOATS, 1, NULL} /* overlay fade distances */
+};
+
+static const struct_schema_t *static_prop_schemas[] = {
+	&static_prop_v4_schema,
+	&static_prop_v5_schema,
+	&static_prop_v6_schema,
+	&static_prop_v7_schema,
+	&static_prop_v8_schema,
+	&static_prop_v9_schema,
+	&static_prop_v10_schema,
+	&static_prop_v11_schema
+};
+
+typedef struct gen_options {
+	Sint64 size;
+	bool lumps[BSP_NUM_LUMPS];
+	Uint64 seed;
+	bool compress;
+	int static_prop_version;
+} gen_options_t;
+
+/* big endian data, grown as it's written */
+typedef struct gen_buffer {
+	Uint8 *data;
+	size_t size;
+	size_t capacity;
+} gen_buffer_t;
+
+static Uint8 *put_space(gen_buffer_t *buffer, size_t size)
+{
+	if (buffer->size + size > buffer->capacity)
+	{
+		buffer->capacity = SDL_max(buffer->capacity * 2, buffer->size + size);
+		buffer->data = SDL_realloc(buffer->data, buffer->capacity);
+	}
+
+	Uint8 *ptr = buffer->data + buffer->size;
+	buffer->size += size;
+	return ptr;
+}
+
+static void put_bytes(gen_buffer_t *buffer, const void *data, size_t size)
+{
+	SDL_memcpy(put_space(buffer, size), data, size);
+}
+
+static void put_u8(gen_buffer_t *buffer, Uint8 value)
+{
+	*put_space(buffer, 1) = value;
+}
+
+static void put_u16(gen_buffer_t *buffer, Uint16 value)
+{
+	value = SDL_Swap16BE(value);
+	put_bytes(buffer, &value, 2);
+}
+
+static void put_u32(gen_buffer_t *buffer, Uint32 value)
+{
+	value = SDL_Swap32BE(value);
+	put_bytes(buffer, &value, 4);
+}
+
+static void put_float(gen_buffer_t *buffer, float value)
+{
+	Uint32 bits;
+	SDL_memcpy(&bits, &value, 4);
+	put_u32(buffer, bits);
+}
+
+static void patch_u32(gen_buffer_t *buffer, size_t offset, Uint32 value)
+{
+	value = SDL_Swap32BE(value);
+	SDL_memcpy(buffer->data + offset, &value, 4);
+}
+
+/* coarse values, so the data compresses about as well as a real map's */
+static float rand_coord(Uint64 *rng)
+{
+	return (float)(SDL_rand_r(rng, 8192) - 4096) * 0.25f;
+}
+
+static void put_word(gen_buffer_t *buffer, gen_kind_t kind, Uint64 *rng)
+{
+	if (kind == GEN_FLOATS)
+		put_float(buffer, rand_coord(rng));
+	else
+		put_u32(buffer, SDL_rand_r(rng, 4096));
+}
+
+static void put_struct(gen_buffer_t *buffer, const struct_schema_t *schema, gen_kind_t kind, Uint64 *rng)
+{
+	for (int i = 0; i < schema->num_fields; i++)
+	{
+		if (schema->fields[i] == 4)
+			put_word(buffer, kind, rng);
+		else if (schema->fields[i] == 2)
+			put_u16(buffer, SDL_rand_r(rng, 4096));
+		else
+			put_u8(buffer, SDL_rand_r(rng, 64));
+	}
+}
+
+static void gen_flat_lump(gen_buffer_t *buffer, const gen_lump_t *info, Sint64 size, Uint64 *rng)
+{
+	if (info->schema)
+	{
+		for (Sint64 i = 0; i < SDL_max(size / (Sint64)info->schema->size, 1); i++)
+			put_struct(buffer, info->schema, info->kind, rng);
+	}
+	else if (info->kind == GEN_SHORTS)
+	{
+		for (Sint64 i = 0; i < SDL_max(size / 2, 1); i++)
+			put_u16(buffer, SDL_rand_r(rng, 4096));
+	}
+	else if (info->kind == GEN_INTS || info->kind == GEN_FLOATS)
+	{
+		for (Sint64 i = 0; i < SDL_max(size / 4, 1); i++)
+			put_word(buffer, info->kind, rng);
+	}
+	else
+	{
+		for (Sint64 i = 0; i < SDL_max(size, 1); i++)
+			put_u8(buffer, SDL_rand_r(rng, 64));
+	}
+}
+
+static void gen_text_lump(gen_buffer_t *buffer, const gen_lump_t *info, Sint64 size, Uint64 *rng)
+{
+	char text[256];
+
+	while ((Sint64)buffer->size < size)
+	{
+		int len;
+		if (info->lump == 0)
+		{
+			len = SDL_snprintf(text, sizeof(text), "{\n\"classname\" \"prop_static\"\n\"origin\" \"%g %g %g\"\n\"angles\" \"0 %d 0\"\n}\n",
+				rand_coord(rng), rand_coord(rng), rand_coord(rng), SDL_rand_r(rng, 360));
+		}
+		else
+		{
+			/* texdata strings are each terminated */
+			len = SDL_snprintf(text, sizeof(text), "materials/gen/surface_%d", SDL_rand_r(rng, 1024)) + 1;
+		}
+
+		put_bytes(buffer, text, len);
+	}
+
+	put_u8(buffer, 0);
+}
+
+static void gen_visibility(gen_buffer_t *buffer, Sint64 size, Uint64 *rng)
+{
+	/* a pvs and a pas bit per cluster pair, plus two offsets per cluster */
+	Sint64 num_clusters = 1;
+	while (4 + (num_clusters + 1) * 8 + (num_clusters + 1) * ((num_clusters + 8) / 8) * 2 <= size)
+		num_clusters++;
+
+	Sint64 row_size = (num_clusters + 7) / 8;
+	Uint32 offset = 4 + num_clusters * 8;
+
+	put_u32(buffer, num_clusters);
+	for (Sint64 i = 0; i < num_clusters * 2; i++, offset += row_size)
+		put_u32(buffer, offset);
+
+	/* mostly empty, like a real map's */
+	for (Sint64 i = 0; i < row_size * num_clusters * 2; i++)
+		put_u8(buffer, SDL_rand_r(rng, 4) == 0 ? SDL_rand_bits_r(rng) : 0);
+}
+
+static void gen_occlusion(gen_buffer_t *buffer, Sint64 size, Uint64 *rng)
+{
+	/* a quarter each for occluders and polys, and the rest for vertex indices, split evenly between them */
+	Sint64 num_occluders = SDL_max(size / 4 / OCCLUDER_SIZE, 1);
+	Sint64 num_polys = SDL_max(size / 4 / OCCLUDER_POLY_SIZE, num_occluders);
+	Sint64 num_vertex_indices = SDL_max(size / 2 / 4, num_polys * 3);
+
+	put_u32(buffer, num_occluders);
+	for (Sint64 i = 0; i < num_occluders; i++)
+	{
+		Sint64 first_poly = i * num_polys / num_occluders;
+		Sint64 last_poly = (i + 1) * num_polys / num_occluders;
+
+		put_u32(buffer, SDL_rand_r(rng, 4));
+		put_u32(buffer, first_poly);
+		put_u32(buffer, last_poly - first_poly);
+		for (int j = 0; j < 6; j++)
+			put_float(buffer, rand_coord(rng));
+		put_u32(buffer, SDL_rand_r(rng, 16));
+	}
+
+	put_u32(buffer, num_polys);
+	for (Sint64 i = 0; i < num_polys; i++)
+	{
+		Sint64 first_vert = i * num_vertex_indices / num_polys;
+		Sint64 last_vert = (i + 1) * num_vertex_indices / num_polys;
+
+		put_u32(buffer, first_vert);
+		put_u32(buffer, last_vert - first_vert);
+		put_u32(buffer, SDL_rand_r(rng, 4096));
+	}
+
+	put_u32(buffer, num_vertex_indices);
+	for (Sint64 i = 0; i < num_vertex_indices; i++)
+		put_u32(buffer, SDL_rand_r(rng, 4096));
+}
+
+static void gen_phys_disp(gen_buffer_t *buffer, Sint64 size, Uint64 *rng)
+{
+	int num_disps = (int)SDL_clamp(size / 258, 1, SDL_MAX_UINT16);
+
+	put_u16(buffer, num_disps);
+	for (int i = 0; i < num_disps; i++)
+		put_u16(buffer, 256);
+
+	for (int i = 0; i < num_disps * 256; i++)
+		put_u8(buffer, SDL_rand_r(rng, 64));
+}
+
+/* the inverse of the converter's bitfield repacking, written as it's read */
+static void put_compact_edge(gen_buffer_t *buffer, Uint16 start_point_index, Sint16 opposite_index, bool is_virtual)
+{
+	Uint32 bitfields = SDL_Swap32(start_point_index | ((Uint32)(opposite_index & 0x7FFF) << 16) | ((Uint32)is_virtual << 31));
+	bitfields = (bitfields >> 16) | ((bitfields & 0xFFFE) << 15) | ((bitfields & 1) << 31);
+
+	bitfields = SDL_Swap32LE(bitfields);
+	put_bytes(buffer, &bitfields, 4);
+}
+
+typedef struct gen_ledgetree_node {
+	int right;
+	int ledge; /* -1 for nodes with children */
+} gen_ledgetree_node_t;
+
+/* a random split of the ledges, laid out depth first with each left child right after its parent */
+static int gen_ledgetree(gen_ledgetree_node_t *nodes, int *num_nodes, int first_ledge, int num_ledges, Uint64 *rng)
+{
+	int node = (*num_nodes)++;
+	nodes[node].right = 0;
+	nodes[node].ledge = -1;
+
+	if (num_ledges == 1)
+	{
+		nodes[node].ledge = first_ledge;
+		return node;
+	}
+
+	int num_left = 1 + SDL_rand_r(rng, num_ledges - 1);
+	gen_ledgetree(nodes, num_nodes, first_ledge, num_left, rng);
+	nodes[node].right = gen_ledgetree(nodes, num_nodes, first_ledge + num_left, num_ledges - num_left, rng);
+
+	return node;
+}
+
+/* a solid from its size onwards, with a compact surface of ledges sharing one point array */
+static void gen_phys_solid(gen_buffer_t *buffer, Uint64 *rng)
+{
+	int num_ledges = 1 + SDL_rand_r(rng, MAX_LEDGES_PER_SOLID);
+	int num_triangles[MAX_LEDGES_PER_SOLID];
+	Uint32 ledge_offsets[MAX_LEDGES_PER_SOLID];
+	gen_ledgetree_node_t nodes[MAX_LEDGES_PER_SOLID * 2];
+
+	/* ledges go right after the compact surface, then the points, then the tree */
+	Uint32 offset = COMPACT_SURFACE_SIZE;
+	int total_triangles = 0;
+	for (int i = 0; i < num_ledges; i++)
+	{
+		num_triangles[i] = 2 + SDL_rand_r(rng, 31);
+		ledge_offsets[i] = offset;
+		offset += 16 + num_triangles[i] * 16;
+		total_triangles += num_triangles[i];
+	}
+
+	int num_points = 3 + total_triangles / 2;
+	Uint32 points_offset = offset;
+	Uint32 nodes_offset = points_offset + num_points * 16;
+
+	int num_nodes = 0;
+	gen_ledgetree(nodes, &num_nodes, 0, num_ledges, rng);
+
+	Uint32 leaf_offsets[MAX_LEDGES_PER_SOLID];
+	for (int i = 0; i < num_nodes; i++)
+		if (nodes[i].ledge >= 0)
+			leaf_offsets[nodes[i].ledge] = nodes_offset + i * LEDGETREE_NODE_SIZE;
+
+	Uint32 surface_size = nodes_offset + num_nodes * LEDGETREE_NODE_SIZE;
+
+	/* size, then the solid and surface headers */
+	put_u32(buffer, 8 + 20 + surface_size);
+	put_u32(buffer, VPHYSICS_MAGIC);
+	put_u16(buffer, VPHYSICS_VERSION);
+	put_u16(buffer, 0);
+	put_u32(buffer, surface_size);
+	for (int i = 0; i < 3; i++)
+		put_float(buffer, i == 2);
+	put_u32(buffer, 0);
+
+	/* compact surface, with the deviation in the first byte of its bitfields and the size in the other three */
+	for (int i = 0; i < 7; i++)
+		put_float(buffer, rand_coord(rng));
+	put_u32(buffer, (Uint32)SDL_rand_r(rng, 256) << 24 | surface_size);
+	put_u32(buffer, nodes_offset);
+	for (int i = 0; i < 3; i++)
+		put_u32(buffer, 0);
+
+	for (int i = 0; i < num_ledges; i++)
+	{
+		put_u32(buffer, points_offset - ledge_offsets[i]);
+		put_u32(buffer, leaf_offsets[i] - ledge_offsets[i]);
+		put_u32(buffer, SDL_rand_bits_r(rng));
+		put_u16(buffer, num_triangles[i]);
+		put_u16(buffer, 0);
+
+		for (int j = 0; j < num_triangles[i]; j++)
+		{
+			put_u32(buffer, SDL_rand_bits_r(rng));
+			for (int k = 0; k < 3; k++)
+				put_compact_edge(buffer, SDL_rand_r(rng, num_points), SDL_rand_r(rng, 64) - 32, SDL_rand_r(rng, 8) == 0);
+		}
+	}
+
+	for (int i = 0; i < num_points * 4; i++)
+		put_float(buffer, rand_coord(rng));
+
+	for (int i = 0; i < num_nodes; i++)
+	{
+		Uint32 node_offset = nodes_offset + i * LEDGETREE_NODE_SIZE;
+		put_u32(buffer, nodes[i].right ? (nodes[i].right - i) * LEDGETREE_NODE_SIZE : 0);
+		put_u32(buffer, nodes[i].ledge >= 0 ? ledge_offsets[nodes[i].ledge] - node_offset : 0);
+		for (int j = 0; j < 4; j++)
+			put_float(buffer, rand_coord(rng));
+		for (int j = 0; j < 3; j++)
+			put_u8(buffer, SDL_rand_r(rng, 256));
+		put_u8(buffer, 0);
+	}
+}
+
+static void gen_physics(gen_buffer_t *buffer, Sint64 size, Uint64 *rng)
+{
+	char keys[64];
+
+	for (int model = 0; model == 0 || (Sint64)buffer->size < size; model++)
+	{
+		int num_solids = 1 + SDL_rand_r(rng, 8);
+		int key_size = SDL_snprintf(keys, sizeof(keys), "solid {\n\"index\" \"%d\"\n}\n", model) + 1;
+
+		size_t header = buffer->size;
+		put_u32(buffer, model);
+		put_u32(buffer, 0);
+		put_u32(buffer, key_size);
+		put_u32(buffer, num_solids);
+
+		for (int i = 0; i < num_solids; i++)
+			gen_phys_solid(buffer, rng);
+
+		patch_u32(buffer, header + 4, buffer->size - header - 16);
+		put_bytes(buffer, keys, key_size);
+	}
+
+	/* ends the list */
+	put_u32(buffer, (Uint32)-1);
+	put_u32(buffer, (Uint32)-1);
+	put_u32(buffer, 0);
+	put_u32(buffer, 0);
+}
+
+static void put_prop_names(gen_buffer_t *buffer, int count)
+{
+	put_u32(buffer, count);
+	for (int i = 0; i < count; i++)
+	{
+		char name[PROP_NAME_SIZE];
+		SDL_zeroa(name);
+		SDL_snprintf(name, sizeof(name), "models/gen/prop_%d.mdl", i);
+		put_bytes(buffer, name, sizeof(name));
+	}
+}
+
+static void gen_static_props(gen_buffer_t *buffer, Sint64 size, int version, Uint64 *rng)
+{
+	const struct_schema_t *schema = static_prop_schemas[version - 4];
+	Sint64 num_props = SDL_max(size / (Sint64)(schema->size + 4), 1);
+
+	put_prop_names(buffer, 16);
+
+	put_u32(buffer, num_props * 2);
+	for (Sint64 i = 0; i < num_props * 2; i++)
+		put_u16(buffer, SDL_rand_r(rng, 4096));
+
+	put_u32(buffer, num_props);
+	for (Sint64 i = 0; i < num_props; i++)
+		put_struct(buffer, schema, GEN_FLOATS, rng);
+}
+
+static void gen_detail_props(gen_buffer_t *buffer, Sint64 size, Uint64 *rng)
+{
+	Sint64 num_sprites = SDL_max(size / 4 / detail_sprite_schema.size, 1);
+	Sint64 num_objects = SDL_max(size * 3 / 4 / detail_object_schema.size, 1);
+
+	put_prop_names(buffer, 4);
+
+	put_u32(buffer, num_sprites);
+	for (Sint64 i = 0; i < num_sprites; i++)
+		put_struct(buffer, &detail_sprite_schema, GEN_FLOATS, rng);
+
+	put_u32(buffer, num_objects);
+	for (Sint64 i = 0; i < num_objects; i++)
+		put_struct(buffer, &detail_object_schema, GEN_FLOATS, rng);
+}
+
+static void gen_detail_prop_lighting(gen_buffer_t *buffer, Sint64 size, Uint64 *rng)
+{
+	Sint64 count = SDL_max(size / DETAIL_PROP_LIGHTSTYLE_SIZE, 1);
+
+	put_u32(buffer, count);
+	for (Sint64 i = 0; i < count * DETAIL_PROP_LIGHTSTYLE_SIZE; i++)
+		put_u8(buffer, SDL_rand_r(rng, 64));
+}
+
+/* compress a buffer into a lump, or leave it alone if it doesn't shrink */
+static bool compress_lump(gen_buffer_t *buffer)
+{
+	size_t capacity = buffer->size;
+	Uint8 *compressed = SDL_malloc(capacity);
+
+	Sint64 size = compress_lzma_buffer(buffer->data, buffer->size, compressed, capacity);
+	if (size < 0)
+	{
+		SDL_free(compressed);
+		return false;
+	}
+
+	SDL_free(buffer->data);
+	buffer->data = compressed;
+	buffer->size = size;
+	buffer->capacity = capacity;
+
+	return true;
+}
+
+/* sub-lumps go right after the directory, each compressed on its own, at offsets from the start of the file */
+static void gen_game_lump(gen_buffer_t *buffer, Sint64 size, Uint32 offset, const gen_options_t *options, Uint64 *rng)
+{
+	static const Uint32 ids[] = {GAME_LUMP_STATIC_PROPS, GAME_LUMP_DETAIL_PROPS, GAME_LUMP_DETAIL_PROP_LIGHTING, GAME_LUMP_DETAIL_PROP_LIGHTING_HDR};
+	static const int shares[] = {60, 30, 5, 5};
+	int num_game_lumps = SDL_arraysize(ids);
+
+	put_u32(buffer, num_game_lumps);
+	put_space(buffer, num_game_lumps * 16);
+
+	for (int i = 0; i < num_game_lumps; i++)
+	{
+		gen_buffer_t data;
+		SDL_zero(data);
+
+		Sint64 game_lump_size = size * shares[i] / 100;
+		int version = 0;
+		if (ids[i] == GAME_LUMP_STATIC_PROPS)
+		{
+			version = options->static_prop_version;
+			gen_static_props(&data, game_lump_size, version, rng);
+		}
+		else if (ids[i] == GAME_LUMP_DETAIL_PROPS)
+		{
+			version = 4;
+			gen_detail_props(&data, game_lump_size, rng);
+		}
+		else
+		{
+			gen_detail_prop_lighting(&data, game_lump_size, rng);
+		}
+
+		Uint16 flags = 0;
+		if (options->compress && compress_lump(&data))
+			flags |= GAME_LUMP_FLAG_COMPRESSED;
+
+		while (buffer->size % 4 != 0)
+			put_u8(buffer, 0);
+
+		Uint8 *entry = buffer->data + 4 + i * 16;
+		Uint32 id = SDL_Swap32BE(ids[i]);
+		Uint16 entry_flags = SDL_Swap16BE(flags);
+		Uint16 entry_version = SDL_Swap16BE(version);
+		Uint32 entry_offset = SDL_Swap32BE(offset + (Uint32)buffer->size);
+		Uint32 entry_length = SDL_Swap32BE((Uint32)data.size);
+		SDL_memcpy(entry, &id, 4);
+		SDL_memcpy(entry + 4, &entry_flags, 2);
+		SDL_memcpy(entry + 6, &entry_version, 2);
+		SDL_memcpy(entry + 8, &entry_offset, 4);
+		SDL_memcpy(entry + 12, &entry_length, 4);
+
+		put_bytes(buffer, data.data, data.size);
+		SDL_free(data.data);
+	}
+}
+
+static bool generate_bsp(const char *filename, const gen_options_t *options, Uint64 seed)
+{
+	Uint64 rng = seed;
+
+	int total_weight = 0;
+	for (int i = 0; i < (int)SDL_arraysize(gen_lumps); i++)
+		if (options->lumps[gen_lumps[i].lump])
+			total_weight += gen_lumps[i].weight;
+
+	SDL_IOStream *io = SDL_IOFromFile(filename, "wb");
+	if (!io)
+	{
+		log_warning("Failed to open \"%s\" for writing", filename);
+		return false;
+	}
+
+	/* the header gets written last, once every lump knows where it went */
+	bsp_header_t header;
+	SDL_zero(header);
+	header.magic = BSP_MAGIC;
+	header.version = BSP_VERSION;
+	header.map_version = 1;
+
+	Uint8 zero[sizeof(bsp_header_t)];
+	SDL_zeroa(zero);
+	SDL_WriteIO(io, zero, sizeof(bsp_header_t));
+	Sint64 offset = sizeof(bsp_header_t);
+
+	bool ok = true;
+	for (int i = 0; i < (int)SDL_arraysize(gen_lumps) && ok; i++)
+	{
+		const gen_lump_t *info = &gen_lumps[i];
+		if (!options->lumps[info->lump])
+			continue;
+
+		Sint64 size = total_weight > 0 ? options->size * info->weight / total_weight : 0;
+
+		/* every lump the converter reads in place starts aligned */
+		Sint64 padding = (4 - offset % 4) % 4;
+		SDL_WriteIO(io, zero, padding);
+		offset += padding;
+
+		gen_buffer_t data;
+		SDL_zero(data);
+
+		switch (info->kind)
+		{
+			case GEN_TEXT: gen_text_lump(&data, info, size, &rng); break;
+			case GEN_VISIBILITY: gen_visibility(&data, size, &rng); break;
+			case GEN_OCCLUSION: gen_occlusion(&data, size, &rng); break;
+			case GEN_PHYS_DISP: gen_phys_disp(&data, size, &rng); break;
+			case GEN_PHYSICS: gen_physics(&data, size, &rng); break;
+			case GEN_GAME_LUMP: gen_game_lump(&data, size, offset, options, &rng); break;
+			default: gen_flat_lump(&data, info, size, &rng); break;
+		}
+
+		bsp_lump_t *lump = &header.lumps[info->lump];
+		lump->offset = offset;
+		lump->version = info->kind == GEN_OCCLUSION ? 1 : 0;
+
+		/* the game lump's directory is never compressed, its sub-lumps are */
+		size_t uncompressed_size = data.size;
+		if (options->compress && info->kind != GEN_GAME_LUMP && compress_lump(&data))
+			lump->identifier = uncompressed_size;
+
+		lump->length = data.size;
+
+		ok = SDL_WriteIO(io, data.data, data.size) == data.size;
+		offset += data.size;
+		SDL_free(data.data);
+
+		if (offset > SDL_MAX_UINT32)
+		{
+			log_warning("\"%s\" is too big for a map", filename);
+			ok = false;
+		}
+	}
+
+	/* the header is nothing but big endian ints */
+	Uint32 *words = (Uint32 *)&header;
+	for (size_t i = 0; i < sizeof(bsp_header_t) / sizeof(Uint32); i++)
+		words[i] = SDL_Swap32BE(words[i]);
+
+	ok = ok && SDL_SeekIO(io, 0, SDL_IO_SEEK_SET) == 0 && SDL_WriteIO(io, &header, sizeof(header)) == sizeof(header);
+	ok = SDL_CloseIO(io) && ok;
+
+	if (!ok)
+		log_warning("Failed to write \"%s\"", filename);
+	else
+		log_info("Generated \"%s\" (%" SDL_PRIs64 " bytes)", filename, offset);
+
+	return ok;
+}
+
+/* comma separated lump indices */
+static bool parse_lump_list(const char *list, bool *lumps)
+{
+	SDL_memset(lumps, 0, sizeof(bool) * BSP_NUM_LUMPS);
+
+	while (*list)
+	{
+		char *end;
+		long lump = SDL_strtol(list, &end, 10);
+		if (end == list || lump < 0 || lump >= BSP_NUM_LUMPS)
+			return false;
+
+		lumps[lump] = true;
+
+		list = *end == ',' ? end + 1 : end;
+		if (*end && *end != ',')
+			return false;
+	}
+
+	return true;
+}
+
+static void print_usage(void)
+{
+	log_info("Usage: bsp360gen [-s megabytes] [-l lumps] [-r seed] [-v version] [-z] file.360.bsp ...");
+	log_info("  -s megabytes  make the lumps add up to about this much uncompressed data (default 16)");
+	log_info("  -l lumps      only generate these lumps, separated by commas");
+	log_info("  -r seed       seed for the random data, counting up for each file (default 1)");
+	log_info("  -v version    static props version, 4 to 11 (default 10)");
+	log_info("  -z            compress lumps with LZMA, like most maps on the disc");
+}
+
+int main(int argc, char **argv)
+{
+	gen_options_t options;
+	options.size = 16 * 1024 * 1024;
+	options.seed = 1;
+	options.compress = false;
+	options.static_prop_version = 10;
+
+	/* every lump the converter can swap, unless told otherwise */
+	SDL_zeroa(options.lumps);
+	for (int i = 0; i < (int)SDL_arraysize(gen_lumps); i++)
+		options.lumps[gen_lumps[i].lump] = true;
+
+	int num_files = 0;
+	char **filenames = SDL_malloc(sizeof(char *) * argc);
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (SDL_strcmp(argv[arg], "-z") == 0)
+		{
+			options.compress = true;
+			continue;
+		}
+
+		if (SDL_strcmp(argv[arg], "-s") == 0 || SDL_strcmp(argv[arg], "-l") == 0 || SDL_strcmp(argv[arg], "-r") == 0 || SDL_strcmp(argv[arg], "-v") == 0)
+		{
+			if (arg + 1 >= argc)
+			{
+				print_usage();
+				num_files = 0;
+				break;
+			}
+
+			if (argv[arg][1] == 's')
+				options.size = SDL_strtoll(argv[arg + 1], NULL, 10) * 1024 * 1024;
+			else if (argv[arg][1] == 'r')
+				options.seed = SDL_strtoull(argv[arg + 1], NULL, 10);
+			else if (argv[arg][1] == 'v')
+				options.static_prop_version = SDL_atoi(argv[arg + 1]);
+			else if (!parse_lump_list(argv[arg + 1], options.lumps))
+			{
+				log_warning("Invalid lump list \"%s\"", argv[arg + 1]);
+				print_usage();
+				num_files = 0;
+				break;
+			}
+
+			arg++;
+			continue;
+		}
+
+		filenames[num_files++] = argv[arg];
+	}
+
+	if (options.static_prop_version < 4 || options.static_prop_version > 11)
+	{
+		log_warning("Static props version must be 4 to 11");
+		print_usage();
+		num_files = 0;
+	}
+
+	for (int i = 0; i < num_files; i++)
+		generate_bsp(filenames[i], &options, options.seed + i);
+
+	SDL_free(filenames);
+
+	SDL_Quit();
+
+	return 0;
+}
@@ -0,0 +1,549 @@
+
+#include <SDL3/SDL.h>
+
+#include "byteswap.h"
+
+/*
+ * scalar kernels, also used for the heads and tails of the simd kernels
+ */
+
+static void swap16_scalar(Uint16 *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		values[i] = SDL_Swap16(values[i]);
+}
+
+static void swap32_scalar(Uint32 *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		values[i] = SDL_Swap32(values[i]);
+}
+
+/* number of values to swap one at a time before the pointer is aligned to the vector size */
+static size_t get_head_count(const void *data, size_t element_size, size_t vector_size, size_t count)
+{
+	uintptr_t misalign = (uintptr_t)data & (vector_size - 1);
+
+	/* can't ever line up, so don't bother */
+	if (misalign == 0 || misalign % element_size != 0)
+		return 0;
+
+	return SDL_min((vector_size - misalign) / element_size, count);
+}
+
+/*
+ * SSSE3 kernels (pshufb)
+ */
+
+#ifdef SDL_SSE4_1_INTRINSICS
+
+SDL_TARGETING("ssse3") static void swap16_ssse3(Uint16 *values, size_t count)
+{
+	size_t head = get_head_count(values, sizeof(Uint16), 16, count);
+	swap16_scalar(values, head);
+	values += head;
+	count -= head;
+
+	const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+		_mm_storeu_si128((__m128i *)(values + i), _mm_shuffle_epi8(v, mask));
+	}
+
+	swap16_scalar(values + i, count - i);
+}
+
+SDL_TARGETING("ssse3") static void swap32_ssse3(Uint32 *values, size_t count)
+{
+	size_t head = get_head_count(values, sizeof(Uint32), 16, count);
+	swap32_scalar(values, head);
+	values += head;
+	count -= head;
+
+	const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+		_mm_storeu_si128((__m128i *)(values + i), _mm_shuffle_epi8(v, mask));
+	}
+
+	swap32_scalar(values + i, count - i);
+}
+
+#endif
+
+/*
+ * AVX2 kernels (vpshufb, two 128-bit lanes at a time)
+ */
+
+#ifdef SDL_AVX2_INTRINSICS
+
+SDL_TARGETING("avx2") static void swap16_avx2(Uint16 *values, size_t count)
+{
+	size_t head = get_head_count(values, sizeof(Uint16), 32, count);
+	swap16_scalar(values, head);
+	values += head;
+	count -= head;
+
+	const __m256i mask = _mm256_setr_epi8(
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+	);
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+		_mm256_storeu_si256((__m256i *)(values + i), _mm256_shuffle_epi8(v, mask));
+	}
+
+	swap16_scalar(values + i, count - i);
+}
+
+SDL_TARGETING("avx2") static void swap32_avx2(Uint32 *values, size_t count)
+{
+	size_t head = get_head_count(values, sizeof(Uint32), 32, count);
+	swap32_scalar(values, head);
+	values += head;
+	count -= head;
+
+	const __m256i mask = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+	);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+		_mm256_storeu_si256((__m256i *)(values + i), _mm256_shuffle_epi8(v, mask));
+	}
+
+	swap32_scalar(values + i, count - i);
+}
+
+#endif
+
+/*
+ * AVX-512 kernels
+ *
+ * SDL only reports AVX-512F, which has no byte shuffle, so these swap the
+ * bytes in each 16-bit half with shifts and masks, and rotate the halves
+ * into place for 32-bit values.
+ */
+
+#ifdef SDL_AVX512F_INTRINSICS
+
+SDL_TARGETING("avx512f") static inline __m512i swap16_pairs_avx512(__m512i v)
+{
+	const __m512i mask = _mm512_set1_epi32((int)0xFF00FF00);
+	return _mm512_or_si512(_mm512_and_si512(_mm512_slli_epi32(v, 8), mask), _mm512_andnot_si512(mask, _mm512_srli_epi32(v, 8)));
+}
+
+SDL_TARGETING("avx512f") static void swap16_avx512(Uint16 *values, size_t count)
+{
+	size_t head = get_head_count(values, sizeof(Uint16), 64, count);
+	swap16_scalar(values, head);
+	values += head;
+	count -= head;
+
+	size_t i = 0;
+	for (; i + 32 <= count; i += 32)
+	{
+		__m512i v = _mm512_loadu_si512((const void *)(values + i));
+		_mm512_storeu_si512((void *)(values + i), swap16_pairs_avx512(v));
+	}
+
+	swap16_scalar(values + i, count - i);
+}
+
+SDL_TARGETING("avx512f") static void swap32_avx512(Uint32 *values, size_t count)
+{
+	size_t head = get_head_count(values, sizeof(Uint32), 64, count);
+	swap32_scalar(values, head);
+	values += head;
+	count -= head;
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i v = _mm512_loadu_si512((const void *)(values + i));
+		_mm512_storeu_si512((void *)(values + i), swap16_pairs_avx512(_mm512_rol_epi32(v, 16)));
+	}
+
+	swap32_scalar(values + i, count - i);
+}
+
+#endif
+
+/*
+ * dispatch
+ */
+
+void swap16_array(void *data, size_t count)
+{
+#ifdef SDL_AVX512F_INTRINSICS
+	if (SDL_HasAVX512F())
+	{
+		swap16_avx512((Uint16 *)data, count);
+		return;
+	}
+#endif
+
+#ifdef SDL_AVX2_INTRINSICS
+	if (SDL_HasAVX2())
+	{
+		swap16_avx2((Uint16 *)data, count);
+		return;
+	}
+#endif
+
+	/* SDL doesn't report SSSE3 on its own, but every CPU with SSE4.1 has it */
+#ifdef SDL_SSE4_1_INTRINSICS
+	if (SDL_HasSSE41())
+	{
+		swap16_ssse3((Uint16 *)data, count);
+		return;
+	}
+#endif
+
+	swap16_scalar((Uint16 *)data, count);
+}
+
+void swap32_array(void *data, size_t count)
+{
+#ifdef SDL_AVX512F_INTRINSICS
+	if (SDL_HasAVX512F())
+	{
+		swap32_avx512((Uint32 *)data, count);
+		return;
+	}
+#endif
+
+#ifdef SDL_AVX2_INTRINSICS
+	if (SDL_HasAVX2())
+	{
+		swap32_avx2((Uint32 *)data, count);
+		return;
+	}
+#endif
+
+	/* SDL doesn't report SSSE3 on its own, but every CPU with SSE4.1 has it */
+#ifdef SDL_SSE4_1_INTRINSICS
+	if (SDL_HasSSE41())
+	{
+		swap32_ssse3((Uint32 *)data, count);
+		return;
+	}
+#endif
+
+	swap32_scalar((Uint32 *)data, count);
+}
+
+/*
+ * struct kernels
+ *
+ * A struct's fields never cross a 16 byte boundary when the struct array is
+ * repeated out to a multiple of 32 bytes, as long as every field is naturally
+ * aligned. That means one pshufb mask per 16 bytes of that period swaps
+ * every field in place, whatever the mix of widths is.
+ */
+
+#define MAX_STRUCT_PERIOD 4096
+
+static void swap_structs_scalar(const struct_schema_t *schema, Uint8 *data, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		Uint8 *field = data + i * schema->size;
+
+		/* arrays inside game lumps aren't always aligned, so go through memcpy */
+		for (int f = 0; f < schema->num_fields; f++)
+		{
+			Uint16 v16;
+			Uint32 v32;
+			Uint64 v64;
+
+			switch (schema->fields[f])
+			{
+				case 2: SDL_memcpy(&v16, field, 2); v16 = SDL_Swap16(v16); SDL_memcpy(field, &v16, 2); break;
+				case 4: SDL_memcpy(&v32, field, 4); v32 = SDL_Swap32(v32); SDL_memcpy(field, &v32, 4); break;
+				case 8: SDL_memcpy(&v64, field, 8); v64 = SDL_Swap64(v64); SDL_memcpy(field, &v64, 8); break;
+				default: break;
+			}
+
+			field += schema->fields[f];
+		}
+	}
+}
+
+static size_t get_struct_period(size_t size)
+{
+	size_t a = size, b = 32;
+	while (b)
+	{
+		size_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return (size / a) * 32;
+}
+
+/* fill in the shuffle mask for one period, returns false if a field crosses a 16 byte boundary */
+static bool build_struct_mask(const struct_schema_t *schema, Uint8 *mask, size_t period)
+{
+	for (size_t base = 0; base < period; base += schema->size)
+	{
+		size_t offset = base;
+
+		for (int f = 0; f < schema->num_fields; f++)
+		{
+			size_t width = schema->fields[f];
+
+			for (size_t b = 0; b < width; b++)
+			{
+				size_t dst = offset + b;
+				size_t src = offset + (width - 1 - b);
+
+				if ((dst >> 4) != (src >> 4))
+					return false;
+
+				mask[dst] = (Uint8)(src & 15);
+			}
+
+			offset += width;
+		}
+	}
+
+	return true;
+}
+
+#ifdef SDL_SSE4_1_INTRINSICS
+
+SDL_TARGETING("ssse3") static size_t swap_structs_ssse3(const Uint8 *mask, size_t period, Uint8 *data, size_t size)
+{
+	size_t i = 0;
+	for (; i + period <= size; i += period)
+	{
+		for (size_t c = 0; c < period; c += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(data + i + c));
+			__m128i m = _mm_loadu_si128((const __m128i *)(mask + c));
+			_mm_storeu_si128((__m128i *)(data + i + c), _mm_shuffle_epi8(v, m));
+		}
+	}
+	return i;
+}
+
+#endif
+
+#ifdef SDL_AVX2_INTRINSICS
+
+SDL_TARGETING("avx2") static size_t swap_structs_avx2(const Uint8 *mask, size_t period, Uint8 *data, size_t size)
+{
+	size_t i = 0;
+	for (; i + period <= size; i += period)
+	{
+		for (size_t c = 0; c < period; c += 32)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i *)(data + i + c));
+			__m256i m = _mm256_loadu_si256((const __m256i *)(mask + c));
+			_mm256_storeu_si256((__m256i *)(data + i + c), _mm256_shuffle_epi8(v, m));
+		}
+	}
+	return i;
+}
+
+#endif
+
+void swap_structs(const struct_schema_t *schema, void *data, size_t count)
+{
+	Uint8 *bytes = (Uint8 *)data;
+	size_t size = count * schema->size;
+	size_t done = 0;
+
+#if defined(SDL_AVX2_INTRINSICS) || defined(SDL_SSE4_1_INTRINSICS)
+	Uint8 mask[MAX_STRUCT_PERIOD];
+	size_t period = get_struct_period(schema->size);
+
+	if (period <= MAX_STRUCT_PERIOD && period <= size && build_struct_mask(schema, mask, period))
+	{
+		bool have_kernel = false;
+
+#ifdef SDL_AVX2_INTRINSICS
+		if (!have_kernel && SDL_HasAVX2())
+		{
+			done = swap_structs_avx2(mask, period, bytes, size);
+			have_kernel = true;
+		}
+#endif
+
+#ifdef SDL_SSE4_1_INTRINSICS
+		if (!have_kernel && SDL_HasSSE41())
+		{
+			done = swap_structs_ssse3(mask, period, bytes, size);
+			have_kernel = true;
+		}
+#endif
+	}
+#endif
+
+	/* whatever didn't fill a whole period */
+	swap_structs_scalar(schema, bytes + done, (size - done) / schema->size);
+}
+
+/*
+ * IVP compact triangle kernels
+ *
+ * A triangle is four 32-bit words: its own bitfields, then one per edge.
+ * Each kind of word gets its bitfields moved around differently before
+ * being swapped, so the vector kernels work out both and keep whichever
+ * applies to each lane, with the masks for the other kind zeroed out.
+ */
+
+static Uint32 repack_compact_triangle(Uint32 x)
+{
+	return ((x & 0x00000FFF) << 20) | ((x & 0x00FFF000) >> 4) | ((x & 0x7F000000) >> 23) | ((x & 0x80000000) >> 31);
+}
+
+static Uint32 repack_compact_edge(Uint32 x)
+{
+	return ((x & 0x0000FFFF) << 16) | ((x & 0x7FFF0000) >> 15) | ((x & 0x80000000) >> 31);
+}
+
+static void swap_compact_triangles_scalar(Uint32 *words, size_t count, Uint16 *point_indices)
+{
+	for (size_t i = 0; i < count; i++, words += 4, point_indices += 3)
+	{
+		words[0] = SDL_Swap32(repack_compact_triangle(words[0]));
+
+		/* the start point index ends up in the low 16 bits */
+		for (int j = 0; j < 3; j++)
+		{
+			words[j + 1] = SDL_Swap32(repack_compact_edge(words[j + 1]));
+			point_indices[j] = (Uint16)words[j + 1];
+		}
+	}
+}
+
+#ifdef SDL_SSE4_1_INTRINSICS
+
+SDL_TARGETING("ssse3") static size_t swap_compact_triangles_ssse3(Uint32 *words, size_t count, Uint16 *point_indices)
+{
+	const __m128i triangle0 = _mm_setr_epi32(0x00000FFF, 0, 0, 0);
+	const __m128i triangle1 = _mm_setr_epi32(0x00FFF000, 0, 0, 0);
+	const __m128i triangle2 = _mm_setr_epi32(0x7F000000, 0, 0, 0);
+	const __m128i edge0 = _mm_setr_epi32(0, 0x0000FFFF, 0x0000FFFF, 0x0000FFFF);
+	const __m128i edge1 = _mm_setr_epi32(0, 0x7FFF0000, 0x7FFF0000, 0x7FFF0000);
+	const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	/* the low 16 bits of each edge, from the first triangle into bytes 0-5 and the second into 6-11 */
+	const __m128i gather0 = _mm_setr_epi8(4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i gather1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128i out[2];
+		for (int t = 0; t < 2; t++)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(words + (i + t) * 4));
+			__m128i r = _mm_or_si128(
+				_mm_or_si128(
+					_mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, triangle0), 20), _mm_srli_epi32(_mm_and_si128(x, triangle1), 4)),
+					_mm_or_si128(_mm_srli_epi32(_mm_and_si128(x, triangle2), 23), _mm_srli_epi32(x, 31))
+				),
+				_mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, edge0), 16), _mm_srli_epi32(_mm_and_si128(x, edge1), 15))
+			);
+			out[t] = _mm_shuffle_epi8(r, swap);
+			_mm_storeu_si128((__m128i *)(words + (i + t) * 4), out[t]);
+		}
+
+		__m128i indices = _mm_or_si128(_mm_shuffle_epi8(out[0], gather0), _mm_shuffle_epi8(out[1], gather1));
+		Uint32 last = (Uint32)_mm_cvtsi128_si32(_mm_srli_si128(indices, 8));
+		_mm_storel_epi64((__m128i *)(point_indices + i * 3), indices);
+		SDL_memcpy(point_indices + i * 3 + 4, &last, 4);
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef SDL_AVX2_INTRINSICS
+
+SDL_TARGETING("avx2") static size_t swap_compact_triangles_avx2(Uint32 *words, size_t count, Uint16 *point_indices)
+{
+	/* shifts can differ per lane here, so each word only needs three */
+	const __m256i mask0 = _mm256_setr_epi32(0x00000FFF, 0x0000FFFF, 0x0000FFFF, 0x0000FFFF, 0x00000FFF, 0x0000FFFF, 0x0000FFFF, 0x0000FFFF);
+	const __m256i shift0 = _mm256_setr_epi32(20, 16, 16, 16, 20, 16, 16, 16);
+	const __m256i mask1 = _mm256_setr_epi32(0x00FFF000, 0x7FFF0000, 0x7FFF0000, 0x7FFF0000, 0x00FFF000, 0x7FFF0000, 0x7FFF0000, 0x7FFF0000);
+	const __m256i shift1 = _mm256_setr_epi32(4, 15, 15, 15, 4, 15, 15, 15);
+	const __m256i triangle2 = _mm256_setr_epi32(0x7F000000, 0, 0, 0, 0x7F000000, 0, 0, 0);
+	const __m256i swap = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+	);
+
+	/* the low 16 bits of each edge, from the first triangle into bytes 0-5 and the second into 6-11 of its lane */
+	const __m256i gather = _mm256_setr_epi8(
+		4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1
+	);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)(words + i * 4));
+		__m256i r = _mm256_or_si256(
+			_mm256_or_si256(_mm256_sllv_epi32(_mm256_and_si256(x, mask0), shift0), _mm256_srlv_epi32(_mm256_and_si256(x, mask1), shift1)),
+			_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(x, triangle2), 23), _mm256_srli_epi32(x, 31))
+		);
+		__m256i out = _mm256_shuffle_epi8(r, swap);
+		_mm256_storeu_si256((__m256i *)(words + i * 4), out);
+
+		__m256i gathered = _mm256_shuffle_epi8(out, gather);
+		__m128i indices = _mm_or_si128(_mm256_castsi256_si128(gathered), _mm256_extracti128_si256(gathered, 1));
+		Uint32 last = (Uint32)_mm_cvtsi128_si32(_mm_srli_si128(indices, 8));
+		_mm_storel_epi64((__m128i *)(point_indices + i * 3), indices);
+		SDL_memcpy(point_indices + i * 3 + 4, &last, 4);
+	}
+
+	return i;
+}
+
+#endif
+
+void swap_compact_triangles(void *data, size_t count, Uint16 *point_indices)
+{
+	Uint32 *words = (Uint32 *)data;
+	size_t done = 0;
+
+	bool have_kernel = false;
+
+#ifdef SDL_AVX2_INTRINSICS
+	if (!have_kernel && SDL_HasAVX2())
+	{
+		done = swap_compact_triangles_avx2(words, count, point_indices);
+		have_kernel = true;
+	}
+#endif
+
+#ifdef SDL_SSE4_1_INTRINSICS
+	if (!have_kernel && SDL_HasSSE41())
+	{
+		done = swap_compact_triangles_ssse3(words, count, point_indices);
+		have_kernel = true;
+	}
+#endif
+
+	(void)have_kernel;
+
+	/* an odd triangle at the end */
+	swap_compact_triangles_scalar(words + done * 4, count - done, point_indices + done * 3);
+}
@@ -0,0 +1,80 @@
+
+#ifndef _BYTESWAP_H_
+#define _BYTESWAP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+/**
+ * \brief byteswap an array of 16-bit values in place
+ *
+ * \param data pointer to the first value, doesn't need to be aligned
+ * \param count number of values to swap
+ *
+ * \author erysdren (it/its)
+ *
+ * \note uses the widest SIMD kernel the CPU supports
+ */
+void swap16_array(void *data, size_t count);
+
+/**
+ * \brief byteswap an array of 32-bit values in place
+ *
+ * \param data pointer to the first value, doesn't need to be aligned
+ * \param count number of values to swap
+ *
+ * \author erysdren (it/its)
+ *
+ * \note uses the widest SIMD kernel the CPU supports
+ */
+void swap32_array(void *data, size_t count);
+
+/**
+ * \brief layout of a struct, as the width of each field in order
+ *
+ * Fields of width 1 are left alone, so padding and byte arrays are described
+ * as a run of 1s. Every field must be naturally aligned within the struct.
+ */
+typedef struct struct_schema {
+	const Uint8 *fields;
+	int num_fields;
+	size_t size;
+} struct_schema_t;
+
+/**
+ * \brief byteswap an array of structs in place
+ *
+ * \param schema layout of the struct
+ * \param data pointer to the first struct, doesn't need to be aligned
+ * \param count number of structs to swap
+ *
+ * \author erysdren (it/its)
+ *
+ * \note builds a shuffle mask covering a whole number of structs and vectors
+ * from the schema, so every struct size gets a branch-free SIMD kernel
+ */
+void swap_structs(const struct_schema_t *schema, void *data, size_t count);
+
+/**
+ * \brief byteswap an array of IVP compact triangles in place, repacking their bitfields
+ *
+ * Each triangle is 16 bytes: a word of triangle bitfields followed by a word
+ * of bitfields for each of its three edges.
+ *
+ * \param data pointer to the first triangle, doesn't need to be aligned
+ * \param count number of triangles to swap
+ * \param point_indices receives the swapped start point index of each edge,
+ * three per triangle
+ *
+ * \author erysdren (it/its)
+ *
+ * \note uses the widest SIMD kernel the CPU supports
+ */
+void swap_compact_triangles(void *data, size_t count, Uint16 *point_indices);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _BYTESWAP_H_ */
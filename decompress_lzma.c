@@ -7,17 +7,14 @@
 
 #define LZMA_MAGIC 0x414d5a4c
 
-#pragma pack(push, 1)
+/* magic, uncompressed size, compressed size, then the 5 lzma properties bytes */
+#define LZMA_SOURCE_HEADER_SIZE 17
 
-typedef struct lzma_header {
-	Uint8 properties;
-	Uint32 dictionary_size;
-	Uint64 uncompressed_size;
-} lzma_header_t;
-
-SDL_COMPILE_TIME_ASSERT(lzma_header_size, sizeof(lzma_header_t) == 13);
-
-#pragma pack(pop)
+/* version, properties size, then the 5 lzma properties bytes, as zip method 14 has them */
+#define LZMA_ZIP_HEADER_SIZE 9
+#define LZMA_ZIP_PROPERTIES_SIZE 5
+#define LZMA_ZIP_VERSION_MAJOR 9
+#define LZMA_ZIP_VERSION_MINOR 20
 
 typedef struct lzma_source_header {
 	Uint32 magic;
@@ -27,83 +24,459 @@ typedef struct lzma_source_header {
 	Uint32 dictionary_size;
 } lzma_source_header_t;
 
-void *decompress_lzma(SDL_IOStream *io, Sint64 *size)
+static bool parse_source_header(const void *src, size_t src_size, lzma_source_header_t *header)
+{
+	const Uint8 *ptr = (const Uint8 *)src;
+
+	if (src_size < LZMA_SOURCE_HEADER_SIZE)
+		return false;
+
+	SDL_memcpy(&header->magic, ptr, 4);
+	SDL_memcpy(&header->uncompressed_size, ptr + 4, 4);
+	SDL_memcpy(&header->compressed_size, ptr + 8, 4);
+	header->properties = ptr[12];
+	SDL_memcpy(&header->dictionary_size, ptr + 13, 4);
+
+	header->magic = SDL_Swap32LE(header->magic);
+	header->uncompressed_size = SDL_Swap32LE(header->uncompressed_size);
+	header->compressed_size = SDL_Swap32LE(header->compressed_size);
+	header->dictionary_size = SDL_Swap32LE(header->dictionary_size);
+
+	return header->magic == LZMA_MAGIC;
+}
+
+Sint64 get_lzma_uncompressed_size(const void *src, size_t src_size)
 {
-	/* validate magic */
 	lzma_source_header_t source_header;
-	SDL_ReadU32LE(io, &source_header.magic);
-	if (source_header.magic != LZMA_MAGIC)
+
+	if (!parse_source_header(src, src_size, &source_header))
+		return -1;
+
+	return source_header.uncompressed_size;
+}
+
+/* a decoder that gets handed back to the pool instead of being freed, so
+ * the next lump can reuse its state and dictionary allocations */
+typedef struct lzma_context {
+	lzma_stream stream;
+	lzma_allocator allocator;
+	int allocations;
+	int first_allocations;
+	bool initialized;
+	struct lzma_context *next;
+} lzma_context_t;
+
+static SDL_SpinLock pool_lock;
+static lzma_context_t *pool_free;
+static lzma_pool_stats_t pool_stats;
+
+static void *context_alloc(void *opaque, size_t nmemb, size_t size)
+{
+	lzma_context_t *context = (lzma_context_t *)opaque;
+	context->allocations++;
+	return SDL_malloc(nmemb * size);
+}
+
+static void *context_alloc_plain(void *opaque, size_t nmemb, size_t size)
+{
+	(void)opaque;
+	return SDL_malloc(nmemb * size);
+}
+
+static void context_free(void *opaque, void *ptr)
+{
+	(void)opaque;
+	SDL_free(ptr);
+}
+
+static lzma_context_t *acquire_context(void)
+{
+	SDL_LockSpinlock(&pool_lock);
+	lzma_context_t *context = pool_free;
+	if (context)
 	{
-		log_warning("Buffer is not LZMA");
-		SDL_SeekIO(io, -4, SDL_IO_SEEK_CUR);
-		return NULL;
+		pool_free = context->next;
+		pool_stats.decoders_reused++;
+	}
+	else
+	{
+		pool_stats.decoders_created++;
 	}
+	SDL_UnlockSpinlock(&pool_lock);
 
-	/* read the rest of the header */
-	SDL_ReadU32LE(io, &source_header.uncompressed_size);
-	SDL_ReadU32LE(io, &source_header.compressed_size);
-	SDL_ReadU8(io, &source_header.properties);
-	SDL_ReadU32LE(io, &source_header.dictionary_size);
+	if (!context)
+	{
+		context = SDL_calloc(1, sizeof(lzma_context_t));
+		if (!context)
+		{
+			log_warning("Failed to allocate LZMA decoder");
+			return NULL;
+		}
 
-	/* allocate buffers */
-	void *compressed = SDL_malloc(sizeof(lzma_header_t) + source_header.compressed_size);
-	void *uncompressed = SDL_malloc(source_header.uncompressed_size);
+		context->stream = (lzma_stream)LZMA_STREAM_INIT;
+		context->allocator.alloc = context_alloc;
+		context->allocator.free = context_free;
+		context->allocator.opaque = context;
+		context->stream.allocator = &context->allocator;
+	}
 
-	/* setup compressed header */
-	lzma_header_t *header = (lzma_header_t *)compressed;
-	header->properties = source_header.properties;
-	header->dictionary_size = source_header.dictionary_size;
-	header->uncompressed_size = (Uint64)source_header.uncompressed_size;
+	context->allocations = 0;
+	return context;
+}
 
-	/* read compressed data */
-	SDL_ReadIO(io, (Uint8 *)compressed + sizeof(lzma_header_t), source_header.compressed_size);
+static void release_context(lzma_context_t *context)
+{
+	SDL_LockSpinlock(&pool_lock);
 
-	/* open decoder */
-	lzma_stream decoder = LZMA_STREAM_INIT;
-	lzma_ret ret = lzma_alone_decoder(&decoder, UINT64_MAX);
-	if (ret != LZMA_OK)
+	/* compare against what a fresh decoder had to allocate */
+	pool_stats.allocations += context->allocations;
+	if (!context->initialized)
+	{
+		context->first_allocations = context->allocations;
+		context->initialized = true;
+	}
+	else if (context->allocations < context->first_allocations)
+	{
+		pool_stats.allocations_avoided += context->first_allocations - context->allocations;
+	}
+
+	context->next = pool_free;
+	pool_free = context;
+
+	SDL_UnlockSpinlock(&pool_lock);
+}
+
+void get_lzma_pool_stats(lzma_pool_stats_t *stats)
+{
+	SDL_LockSpinlock(&pool_lock);
+	*stats = pool_stats;
+	SDL_UnlockSpinlock(&pool_lock);
+}
+
+void free_lzma_pool(void)
+{
+	SDL_LockSpinlock(&pool_lock);
+	lzma_context_t *context = pool_free;
+	pool_free = NULL;
+	SDL_UnlockSpinlock(&pool_lock);
+
+	while (context)
+	{
+		lzma_context_t *next = context->next;
+		lzma_end(&context->stream);
+		SDL_free(context);
+		context = next;
+	}
+}
+
+/* unpack lc/lp/pb from the properties byte, like an .lzma header would */
+static bool init_decoder(lzma_stream *decoder, Uint8 properties, Uint32 dictionary_size)
+{
+	if (properties >= 9 * 5 * 5)
+	{
+		log_warning("LZMA buffer has invalid properties");
+		return false;
+	}
+
+	lzma_options_lzma options;
+	SDL_zero(options);
+	options.dict_size = dictionary_size;
+	options.lc = properties % 9;
+	options.lp = (properties / 9) % 5;
+	options.pb = properties / (9 * 5);
+
+	lzma_filter filters[2] = {
+		{LZMA_FILTER_LZMA1, &options},
+		{LZMA_VLI_UNKNOWN, NULL}
+	};
+
+	/* (re)initialize decoder, which keeps its allocations if it can */
+	if (lzma_raw_decoder(decoder, filters) != LZMA_OK)
 	{
 		log_warning("Failed to initialize LZMA decoder");
-		SDL_free(compressed);
-		SDL_free(uncompressed);
-		return NULL;
+		return false;
 	}
 
-	/* initialize decoder */
-	decoder.next_in = compressed;
-	decoder.avail_in = sizeof(lzma_header_t) + source_header.compressed_size;
-	decoder.next_out = uncompressed;
-	decoder.avail_out = source_header.uncompressed_size;
+	return true;
+}
 
-	/* do decompression */
-	bool error = false;
-	while (1)
+static bool open_decoder(const void *src, size_t src_size, lzma_source_header_t *source_header, lzma_stream *decoder)
+{
+	/* validate header */
+	if (!parse_source_header(src, src_size, source_header))
 	{
-		ret = lzma_code(&decoder, LZMA_RUN);
+		log_warning("Buffer is not LZMA");
+		return false;
+	}
+
+	if (source_header->compressed_size > src_size - LZMA_SOURCE_HEADER_SIZE)
+	{
+		log_warning("LZMA buffer is truncated");
+		return false;
+	}
+
+	if (!init_decoder(decoder, source_header->properties, source_header->dictionary_size))
+		return false;
+
+	decoder->next_in = (const Uint8 *)src + LZMA_SOURCE_HEADER_SIZE;
+	decoder->avail_in = source_header->compressed_size;
+
+	return true;
+}
+
+static bool decode_into(lzma_stream *decoder, void *dst, size_t dst_size)
+{
+	decoder->next_out = dst;
+	decoder->avail_out = dst_size;
 
-		if (decoder.avail_out == 0 || ret == LZMA_STREAM_END)
+	while (decoder->avail_out > 0)
+	{
+		lzma_ret ret = lzma_code(decoder, LZMA_RUN);
+
+		if (ret == LZMA_STREAM_END)
 		{
+			/* the stream ended before filling the output */
+			if (decoder->avail_out > 0)
+			{
+				log_warning("LZMA buffer is shorter than its header says");
+				return false;
+			}
 			break;
 		}
 		else if (ret != LZMA_OK)
 		{
 			log_warning("Failed to decompress LZMA buffer");
-			error = true;
-			break;
+			return false;
 		}
 	}
 
+	return true;
+}
+
+bool decompress_lzma_buffer(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	lzma_source_header_t source_header;
+	lzma_context_t *context = acquire_context();
+	if (!context)
+		return false;
+
+	lzma_stream *decoder = &context->stream;
+
+	if (!open_decoder(src, src_size, &source_header, decoder))
+	{
+		release_context(context);
+		return false;
+	}
+
+	if (source_header.uncompressed_size > dst_size)
+	{
+		log_warning("LZMA output buffer is too small");
+		release_context(context);
+		return false;
+	}
+
+	/* do decompression */
+	bool ok = decode_into(decoder, dst, source_header.uncompressed_size);
+
+	/* clean up */
+	release_context(context);
+
+	return ok;
+}
+
+bool decompress_lzma_window(const void *src, size_t src_size, void *window, size_t window_size, size_t alignment, lzma_window_func_t func, void *userdata)
+{
+	/* every chunk but the last is a whole number of elements */
+	size_t chunk_size = alignment > 0 ? window_size - window_size % alignment : window_size;
+	if (chunk_size == 0)
+	{
+		log_warning("LZMA window is smaller than one element");
+		return false;
+	}
+
+	lzma_source_header_t source_header;
+	lzma_context_t *context = acquire_context();
+	if (!context)
+		return false;
+
+	lzma_stream *decoder = &context->stream;
+
+	if (!open_decoder(src, src_size, &source_header, decoder))
+	{
+		release_context(context);
+		return false;
+	}
+
+	/* fill the window, hand it over, repeat */
+	bool ok = true;
+	Sint64 offset = 0;
+	while (ok && offset < source_header.uncompressed_size)
+	{
+		size_t size = SDL_min(chunk_size, (size_t)(source_header.uncompressed_size - offset));
+
+		ok = decode_into(decoder, window, size) && func(window, size, offset, userdata);
+
+		offset += size;
+	}
+
 	/* clean up */
-	lzma_end(&decoder);
-	SDL_free(compressed);
+	release_context(context);
 
-	/* there was an error */
-	if (error)
+	return ok;
+}
+
+bool decompress_lzma_zip_entry(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	const Uint8 *ptr = (const Uint8 *)src;
+
+	/* some tools wrap zip entries the same way as lumps */
+	Sint64 uncompressed_size = get_lzma_uncompressed_size(src, src_size);
+	if (uncompressed_size >= 0)
 	{
-		SDL_free(uncompressed);
-		return NULL;
+		if ((Uint64)uncompressed_size != dst_size)
+		{
+			log_warning("LZMA zip entry size doesn't match its header");
+			return false;
+		}
+
+		return decompress_lzma_buffer(src, src_size, dst, dst_size);
 	}
 
-	if (size) *size = source_header.uncompressed_size;
-	return uncompressed;
+	/* version, properties size, then the properties themselves */
+	if (src_size < LZMA_ZIP_HEADER_SIZE || ptr[2] != LZMA_ZIP_PROPERTIES_SIZE || ptr[3] != 0)
+	{
+		log_warning("LZMA zip entry has an invalid header");
+		return false;
+	}
+
+	Uint32 dictionary_size;
+	SDL_memcpy(&dictionary_size, ptr + 5, 4);
+	dictionary_size = SDL_Swap32LE(dictionary_size);
+
+	lzma_context_t *context = acquire_context();
+	if (!context)
+		return false;
+
+	lzma_stream *decoder = &context->stream;
+
+	if (!init_decoder(decoder, ptr[4], dictionary_size))
+	{
+		release_context(context);
+		return false;
+	}
+
+	/* the zip headers have the size, so the end marker is optional */
+	decoder->next_in = ptr + LZMA_ZIP_HEADER_SIZE;
+	decoder->avail_in = src_size - LZMA_ZIP_HEADER_SIZE;
+
+	bool ok = decode_into(decoder, dst, dst_size);
+
+	release_context(context);
+
+	return ok;
+}
+
+/* raw LZMA1 with an end marker, returning the compressed size or -1 if it didn't fit */
+static Sint64 encode_raw(const void *src, size_t src_size, void *dst, size_t dst_size, Uint8 *properties, Uint32 *dictionary_size)
+{
+	lzma_options_lzma options;
+	if (lzma_lzma_preset(&options, LZMA_PRESET_DEFAULT))
+		return -1;
+
+	/* no point in a dictionary bigger than the file */
+	while (options.dict_size / 2 >= SDL_max(src_size, LZMA_DICT_SIZE_MIN))
+		options.dict_size /= 2;
+
+	lzma_filter filters[2] = {
+		{LZMA_FILTER_LZMA1, &options},
+		{LZMA_VLI_UNKNOWN, NULL}
+	};
+
+	/* encoders aren't pooled, there's only ever one per buffer */
+	lzma_allocator allocator = {context_alloc_plain, context_free, NULL};
+	lzma_stream encoder = LZMA_STREAM_INIT;
+	encoder.allocator = &allocator;
+
+	if (lzma_raw_encoder(&encoder, filters) != LZMA_OK)
+	{
+		log_warning("Failed to initialize LZMA encoder");
+		return -1;
+	}
+
+	encoder.next_in = src;
+	encoder.avail_in = src_size;
+	encoder.next_out = dst;
+	encoder.avail_out = dst_size;
+
+	/* running out of room means it didn't compress, which isn't an error */
+	lzma_ret ret;
+	do
+	{
+		ret = lzma_code(&encoder, LZMA_FINISH);
+	}
+	while (ret == LZMA_OK && encoder.avail_out > 0);
+
+	Sint64 size = encoder.total_out;
+	lzma_end(&encoder);
+
+	if (ret != LZMA_STREAM_END)
+		return -1;
+
+	*properties = (Uint8)((options.pb * 5 + options.lp) * 9 + options.lc);
+	*dictionary_size = options.dict_size;
+
+	return size;
+}
+
+Sint64 compress_lzma_zip_entry(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	Uint8 *ptr = (Uint8 *)dst;
+
+	if (dst_size <= LZMA_ZIP_HEADER_SIZE)
+		return -1;
+
+	Uint8 properties;
+	Uint32 dictionary_size;
+	Sint64 size = encode_raw(src, src_size, ptr + LZMA_ZIP_HEADER_SIZE, dst_size - LZMA_ZIP_HEADER_SIZE, &properties, &dictionary_size);
+	if (size < 0)
+		return -1;
+
+	ptr[0] = LZMA_ZIP_VERSION_MAJOR;
+	ptr[1] = LZMA_ZIP_VERSION_MINOR;
+	ptr[2] = LZMA_ZIP_PROPERTIES_SIZE;
+	ptr[3] = 0;
+	ptr[4] = properties;
+
+	dictionary_size = SDL_Swap32LE(dictionary_size);
+	SDL_memcpy(ptr + 5, &dictionary_size, 4);
+
+	return LZMA_ZIP_HEADER_SIZE + size;
+}
+
+Sint64 compress_lzma_buffer(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+	Uint8 *ptr = (Uint8 *)dst;
+
+	if (dst_size <= LZMA_SOURCE_HEADER_SIZE || src_size > SDL_MAX_UINT32)
+		return -1;
+
+	Uint8 properties;
+	Uint32 dictionary_size;
+	Sint64 size = encode_raw(src, src_size, ptr + LZMA_SOURCE_HEADER_SIZE, dst_size - LZMA_SOURCE_HEADER_SIZE, &properties, &dictionary_size);
+	if (size < 0 || size > SDL_MAX_UINT32)
+		return -1;
+
+	/* the same little endian header parse_source_header() reads */
+	Uint32 magic = SDL_Swap32LE(LZMA_MAGIC);
+	Uint32 uncompressed_size = SDL_Swap32LE((Uint32)src_size);
+	Uint32 compressed_size = SDL_Swap32LE((Uint32)size);
+	dictionary_size = SDL_Swap32LE(dictionary_size);
+
+	SDL_memcpy(ptr, &magic, 4);
+	SDL_memcpy(ptr + 4, &uncompressed_size, 4);
+	SDL_memcpy(ptr + 8, &compressed_size, 4);
+	ptr[12] = properties;
+	SDL_memcpy(ptr + 13, &dictionary_size, 4);
+
+	return LZMA_SOURCE_HEADER_SIZE + size;
 }
@@ -7,19 +7,145 @@ extern "C" {
 
 #include <SDL3/SDL.h>
 
+typedef struct lzma_pool_stats {
+	Sint64 decoders_created;
+	Sint64 decoders_reused;
+	Sint64 allocations;
+	Sint64 allocations_avoided;
+} lzma_pool_stats_t;
+
+/**
+ * \brief called with each chunk of a windowed LZMA decompression
+ *
+ * \param data the decompressed chunk, which may be modified
+ * \param size size of the chunk
+ * \param offset offset of the chunk in the decompressed data
+ * \param userdata user pointer passed to decompress_lzma_window()
+ *
+ * \returns true to continue, false to stop decompressing
+ */
+typedef bool (*lzma_window_func_t)(void *data, size_t size, Sint64 offset, void *userdata);
+
+/**
+ * \brief get the decompressed size of an LZMA buffer in memory
+ *
+ * \param src the LZMA buffer, starting with its header
+ * \param src_size size of the LZMA buffer
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the decompressed size, or -1 if the buffer is not LZMA
+ */
+Sint64 get_lzma_uncompressed_size(const void *src, size_t src_size);
+
+/**
+ * \brief decompress an LZMA buffer in memory into another buffer
+ *
+ * \param src the LZMA buffer, starting with its header
+ * \param src_size size of the LZMA buffer
+ * \param dst buffer to decompress into
+ * \param dst_size size of the output buffer
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note the compressed data is decoded where it is, without being copied
+ * \note dst_size must be at least get_lzma_uncompressed_size()
+ */
+bool decompress_lzma_buffer(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+/**
+ * \brief decompress an LZMA buffer in memory through a fixed size window
+ *
+ * \param src the LZMA buffer, starting with its header
+ * \param src_size size of the LZMA buffer
+ * \param window buffer to decompress each chunk into
+ * \param window_size size of the window buffer
+ * \param alignment chunks are cut on multiples of this many bytes
+ * \param func function to call with each chunk
+ * \param userdata user pointer to pass to func
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error or if func returned false
+ *
+ * \note only the last chunk can be shorter than the window, and it is only
+ * a whole number of elements if the decompressed size is
+ */
+bool decompress_lzma_window(const void *src, size_t src_size, void *window, size_t window_size, size_t alignment, lzma_window_func_t func, void *userdata);
+
 /**
- * \brief decompress an LZMA buffer from the current point in the IOStream
+ * \brief decompress an LZMA compressed zip entry in memory
  *
- * \param io the IOStream to read from
- * \param size pointer to fill with the size of the decompressed buffer
+ * \param src the entry's data, starting with its LZMA header
+ * \param src_size size of the entry's data
+ * \param dst buffer to decompress into
+ * \param dst_size uncompressed size of the entry
  *
  * \author erysdren (it/its)
  *
- * \returns the decompressed buffer, or NULL on error
+ * \returns true on success, false on error
+ *
+ * \note this is zip compression method 14, and entries wrapped like lumps
+ * are handled too
+ */
+bool decompress_lzma_zip_entry(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+/**
+ * \brief compress a buffer into an LZMA zip entry
+ *
+ * \param src the data to compress
+ * \param src_size size of the data
+ * \param dst buffer to compress into
+ * \param dst_size size of the output buffer
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the compressed size, or -1 if it didn't fit or on error
+ *
+ * \note the output always ends with an end marker, so entries using it
+ * need general purpose flag bit 1 set
+ */
+Sint64 compress_lzma_zip_entry(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+/**
+ * \brief compress a buffer into an LZMA buffer, wrapped like a lump
+ *
+ * \param src the data to compress
+ * \param src_size size of the data
+ * \param dst buffer to compress into
+ * \param dst_size size of the output buffer
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the compressed size including its header, or -1 if it didn't fit
+ * or on error
+ *
+ * \note the output can be read back with decompress_lzma_buffer()
+ */
+Sint64 compress_lzma_buffer(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+/**
+ * \brief get statistics about the pool of reusable LZMA decoders
+ *
+ * \param stats pointer to fill with the statistics
+ *
+ * \author erysdren (it/its)
+ *
+ * \note decoders are pooled across every thread and every file, so lumps
+ * decoded one after another reuse the same decoder state and dictionary
+ */
+void get_lzma_pool_stats(lzma_pool_stats_t *stats);
+
+/**
+ * \brief free every pooled LZMA decoder
+ *
+ * \author erysdren (it/its)
  *
- * \note return buffer must be freed with SDL_free()
+ * \note must not be called while anything is being decompressed
  */
-void *decompress_lzma(SDL_IOStream *io, Sint64 *size);
+void free_lzma_pool(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,137 @@
+
+/* generated by python/gen_lump_schemas.py from kaitai/bsp360.ksy, do not edit */
+
+#ifndef _LUMP_SCHEMAS_H_
+#define _LUMP_SCHEMAS_H_
+
+#include "byteswap.h"
+
+#define SCHEMA_NODE_SIZE 32
+static const Uint8 node_fields[13] = {
+	4, 4, 4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+};
+static const struct_schema_t node_schema = { node_fields, 13, SCHEMA_NODE_SIZE };
+
+#define SCHEMA_FACE_SIZE 56
+static const Uint8 face_fields[22] = {
+	2, 1, 1, 4, 2, 2, 2, 2, 1, 1, 1, 1, 4, 4, 4, 4,
+	4, 4, 4, 2, 2, 4,
+};
+static const struct_schema_t face_schema = { face_fields, 22, SCHEMA_FACE_SIZE };
+
+#define SCHEMA_LEAF_SIZE 32
+static const Uint8 leaf_fields[16] = {
+	4, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1,
+};
+static const struct_schema_t leaf_schema = { leaf_fields, 16, SCHEMA_LEAF_SIZE };
+
+#define SCHEMA_AREAPORTAL_SIZE 12
+static const Uint8 areaportal_fields[5] = {
+	2, 2, 2, 2, 4,
+};
+static const struct_schema_t areaportal_schema = { areaportal_fields, 5, SCHEMA_AREAPORTAL_SIZE };
+
+#define SCHEMA_DISP_INFO_SIZE 176
+static const Uint8 disp_info_fields[88] = {
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 2, 1, 1, 4, 4, 2, 1,
+	1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1,
+	1, 1, 2, 1, 1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1, 1,
+	1, 2, 1, 1, 1, 1, 2, 2, 2, 2, 1, 1, 2, 2, 2, 2,
+	1, 1, 2, 2, 2, 2, 1, 1, 2, 2, 2, 2, 1, 1, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4,
+};
+static const struct_schema_t disp_info_schema = { disp_info_fields, 88, SCHEMA_DISP_INFO_SIZE };
+
+#define SCHEMA_LEAF_WATER_DATA_SIZE 12
+static const Uint8 leaf_water_data_fields[5] = {
+	4, 4, 2, 1, 1,
+};
+static const struct_schema_t leaf_water_data_schema = { leaf_water_data_fields, 5, SCHEMA_LEAF_WATER_DATA_SIZE };
+
+#define SCHEMA_PRIMITIVE_SIZE 10
+static const Uint8 primitive_fields[6] = {
+	1, 1, 2, 2, 2, 2,
+};
+static const struct_schema_t primitive_schema = { primitive_fields, 6, SCHEMA_PRIMITIVE_SIZE };
+
+#define SCHEMA_OVERLAY_SIZE 352
+static const Uint8 overlay_fields[89] = {
+	4, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	4, 4, 4, 4, 4, 4, 4, 4, 4,
+};
+static const struct_schema_t overlay_schema = { overlay_fields, 89, SCHEMA_OVERLAY_SIZE };
+
+#define SCHEMA_STATIC_PROP_V4_SIZE 56
+static const Uint8 static_prop_v4_fields[17] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4,
+};
+static const struct_schema_t static_prop_v4_schema = { static_prop_v4_fields, 17, SCHEMA_STATIC_PROP_V4_SIZE };
+
+#define SCHEMA_STATIC_PROP_V5_SIZE 60
+static const Uint8 static_prop_v5_fields[18] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4,
+};
+static const struct_schema_t static_prop_v5_schema = { static_prop_v5_fields, 18, SCHEMA_STATIC_PROP_V5_SIZE };
+
+#define SCHEMA_STATIC_PROP_V6_SIZE 64
+static const Uint8 static_prop_v6_fields[20] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4, 2, 2,
+};
+static const struct_schema_t static_prop_v6_schema = { static_prop_v6_fields, 20, SCHEMA_STATIC_PROP_V6_SIZE };
+
+#define SCHEMA_STATIC_PROP_V7_SIZE 68
+static const Uint8 static_prop_v7_fields[24] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4, 2, 2, 1, 1, 1, 1,
+};
+static const struct_schema_t static_prop_v7_schema = { static_prop_v7_fields, 24, SCHEMA_STATIC_PROP_V7_SIZE };
+
+#define SCHEMA_STATIC_PROP_V8_SIZE 68
+static const Uint8 static_prop_v8_fields[26] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+static const struct_schema_t static_prop_v8_schema = { static_prop_v8_fields, 26, SCHEMA_STATIC_PROP_V8_SIZE };
+
+#define SCHEMA_STATIC_PROP_V9_SIZE 72
+static const Uint8 static_prop_v9_fields[30] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+static const struct_schema_t static_prop_v9_schema = { static_prop_v9_fields, 30, SCHEMA_STATIC_PROP_V9_SIZE };
+
+#define SCHEMA_STATIC_PROP_V10_SIZE 76
+static const Uint8 static_prop_v10_fields[31] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 4,
+};
+static const struct_schema_t static_prop_v10_schema = { static_prop_v10_fields, 31, SCHEMA_STATIC_PROP_V10_SIZE };
+
+#define SCHEMA_STATIC_PROP_V11_SIZE 80
+static const Uint8 static_prop_v11_fields[32] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 2, 1, 1, 4, 4, 4, 4, 4,
+	4, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 4, 4,
+};
+static const struct_schema_t static_prop_v11_schema = { static_prop_v11_fields, 32, SCHEMA_STATIC_PROP_V11_SIZE };
+
+#define SCHEMA_DETAIL_SPRITE_SIZE 32
+static const Uint8 detail_sprite_fields[8] = {
+	4, 4, 4, 4, 4, 4, 4, 4,
+};
+static const struct_schema_t detail_sprite_schema = { detail_sprite_fields, 8, SCHEMA_DETAIL_SPRITE_SIZE };
+
+#define SCHEMA_DETAIL_OBJECT_SIZE 52
+static const Uint8 detail_object_fields[26] = {
+	4, 4, 4, 4, 4, 4, 2, 2, 1, 1, 1, 1, 4, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 4,
+};
+static const struct_schema_t detail_object_schema = { detail_object_fields, 26, SCHEMA_DETAIL_OBJECT_SIZE };
+
+#endif /* _LUMP_SCHEMAS_H_ */
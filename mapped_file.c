@@ -0,0 +1,62 @@
+
+#include <SDL3/SDL.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+#include "utils.h"
+
+#ifdef HAVE_MMAP
+
+void *map_file(const char *filename, size_t *size)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	/* private mapping, so we can swap in place without touching the file */
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		log_warning("Failed to map \"%s\"", filename);
+		return NULL;
+	}
+
+	if (size) *size = (size_t)st.st_size;
+	return data;
+}
+
+void unmap_file(void *data, size_t size)
+{
+	if (data)
+		munmap(data, size);
+}
+
+#else
+
+void *map_file(const char *filename, size_t *size)
+{
+	return SDL_LoadFile(filename, size);
+}
+
+void unmap_file(void *data, size_t size)
+{
+	SDL_free(data);
+}
+
+#endif
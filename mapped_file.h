@@ -0,0 +1,41 @@
+
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+/**
+ * \brief map a whole file into memory as a private, writable copy
+ *
+ * \param filename the file to map
+ * \param size pointer to fill with the size of the file
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns pointer to the file data, or NULL on error
+ *
+ * \note writes to the returned buffer never reach the file on disk. pages are
+ * only copied when they're written to, where mmap() is available, and the
+ * whole file is loaded into memory otherwise.
+ *
+ * \note return buffer must be released with unmap_file()
+ */
+void *map_file(const char *filename, size_t *size);
+
+/**
+ * \brief release a file mapped with map_file()
+ *
+ * \param data pointer returned by map_file()
+ * \param size size returned by map_file()
+ *
+ * \author erysdren (it/its)
+ */
+void unmap_file(void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _MAPPED_FILE_H_ */
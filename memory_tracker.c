@@ -0,0 +1,348 @@
+#include <SDL3/SDL.h>
+
+#include "memory_tracker.h"
+#include "utils.h"
+
+/* keeps everything after it as aligned as it came from the allocator */
+#define MEMORY_HEADER_SIZE 16
+#define MAX_MEMORY_STAGES 16
+#define MAX_MEMORY_SITES_REPORTED 10
+
+typedef struct memory_header {
+	size_t size;
+	int site; /* file * MAX_MEMORY_STAGES + stage */
+} memory_header_t;
+
+SDL_COMPILE_TIME_ASSERT(memory_header_size, sizeof(memory_header_t) <= MEMORY_HEADER_SIZE);
+
+typedef struct memory_stats {
+	Sint64 allocations;
+	Sint64 bytes;
+	Sint64 live;
+	Sint64 peak;
+} memory_stats_t;
+
+typedef struct memory_file {
+	const char *filename;
+	memory_stats_t stats;
+	memory_stats_t stages[MAX_MEMORY_STAGES];
+} memory_file_t;
+
+typedef struct memory_site {
+	int file;
+	int stage;
+	memory_stats_t stats;
+} memory_site_t;
+
+static bool installed;
+static SDL_malloc_func original_malloc;
+static SDL_calloc_func original_calloc;
+static SDL_realloc_func original_realloc;
+static SDL_free_func original_free;
+
+/* the tables are allocated with the original functions, so they don't count themselves */
+static SDL_SpinLock memory_lock;
+static memory_stats_t memory_total;
+static const char *memory_stage_names[MAX_MEMORY_STAGES] = {"other"};
+static int num_memory_stages = 1;
+static memory_stats_t memory_stages[MAX_MEMORY_STAGES];
+static memory_file_t *memory_files; /* the first one is for anything allocated outside a file */
+static int num_memory_files;
+static int max_memory_files;
+
+/* the thread's file and stage indices, stored as pointers */
+static SDL_TLSID memory_file_tls;
+static SDL_TLSID memory_stage_tls;
+
+static void add_stats(memory_stats_t *stats, size_t size)
+{
+	stats->allocations++;
+	stats->bytes += size;
+	stats->live += size;
+	if (stats->live > stats->peak)
+		stats->peak = stats->live;
+}
+
+static void track(memory_header_t *header, size_t size)
+{
+	memory_context_t context;
+	get_memory_context(&context);
+
+	header->size = size;
+	header->site = context.file * MAX_MEMORY_STAGES + context.stage;
+
+	SDL_LockSpinlock(&memory_lock);
+	add_stats(&memory_total, size);
+	add_stats(&memory_stages[context.stage], size);
+	add_stats(&memory_files[context.file].stats, size);
+	add_stats(&memory_files[context.file].stages[context.stage], size);
+	SDL_UnlockSpinlock(&memory_lock);
+}
+
+/* freed memory comes off whatever file and stage allocated it */
+static void untrack(const memory_header_t *header)
+{
+	int file = header->site / MAX_MEMORY_STAGES;
+	int stage = header->site % MAX_MEMORY_STAGES;
+	Sint64 size = (Sint64)header->size;
+
+	SDL_LockSpinlock(&memory_lock);
+	memory_total.live -= size;
+	memory_stages[stage].live -= size;
+	memory_files[file].stats.live -= size;
+	memory_files[file].stages[stage].live -= size;
+	SDL_UnlockSpinlock(&memory_lock);
+}
+
+static void *SDLCALL tracked_malloc(size_t size)
+{
+	if (size > SDL_SIZE_MAX - MEMORY_HEADER_SIZE)
+		return NULL;
+
+	Uint8 *block = original_malloc(MEMORY_HEADER_SIZE + size);
+	if (!block)
+		return NULL;
+
+	track((memory_header_t *)block, size);
+
+	return block + MEMORY_HEADER_SIZE;
+}
+
+static void *SDLCALL tracked_calloc(size_t nmemb, size_t size)
+{
+	if (size > 0 && nmemb > (SDL_SIZE_MAX - MEMORY_HEADER_SIZE) / size)
+		return NULL;
+
+	Uint8 *block = original_calloc(1, MEMORY_HEADER_SIZE + nmemb * size);
+	if (!block)
+		return NULL;
+
+	track((memory_header_t *)block, nmemb * size);
+
+	return block + MEMORY_HEADER_SIZE;
+}
+
+static void *SDLCALL tracked_realloc(void *mem, size_t size)
+{
+	if (!mem)
+		return tracked_malloc(size);
+
+	if (size > SDL_SIZE_MAX - MEMORY_HEADER_SIZE)
+		return NULL;
+
+	memory_header_t old_header = *(memory_header_t *)((Uint8 *)mem - MEMORY_HEADER_SIZE);
+
+	Uint8 *block = original_realloc((Uint8 *)mem - MEMORY_HEADER_SIZE, MEMORY_HEADER_SIZE + size);
+	if (!block)
+		return NULL;
+
+	/* counted as a new allocation by whoever grew it */
+	untrack(&old_header);
+	track((memory_header_t *)block, size);
+
+	return block + MEMORY_HEADER_SIZE;
+}
+
+static void SDLCALL tracked_free(void *mem)
+{
+	if (!mem)
+		return;
+
+	memory_header_t *header = (memory_header_t *)((Uint8 *)mem - MEMORY_HEADER_SIZE);
+	untrack(header);
+	original_free(header);
+}
+
+bool install_memory_tracker(void)
+{
+	if (installed)
+		return true;
+
+	SDL_GetMemoryFunctions(&original_malloc, &original_calloc, &original_realloc, &original_free);
+
+	max_memory_files = 64;
+	memory_files = original_calloc(max_memory_files, sizeof(memory_file_t));
+	memory_files[0].filename = "(no file)";
+	num_memory_files = 1;
+
+	if (!SDL_SetMemoryFunctions(tracked_malloc, tracked_calloc, tracked_realloc, tracked_free))
+	{
+		log_warning("Failed to install memory tracker");
+		original_free(memory_files);
+		memory_files = NULL;
+		return false;
+	}
+
+	installed = true;
+
+	return true;
+}
+
+void get_memory_context(memory_context_t *context)
+{
+	context->file = 0;
+	context->stage = 0;
+
+	if (!installed)
+		return;
+
+	context->file = (int)(intptr_t)SDL_GetTLS(&memory_file_tls);
+	context->stage = (int)(intptr_t)SDL_GetTLS(&memory_stage_tls);
+}
+
+void set_memory_context(const memory_context_t *context)
+{
+	if (!installed)
+		return;
+
+	/* setting these can allocate, so the lock can't be held */
+	SDL_SetTLS(&memory_file_tls, (void *)(intptr_t)context->file, NULL);
+	SDL_SetTLS(&memory_stage_tls, (void *)(intptr_t)context->stage, NULL);
+}
+
+void set_memory_file(const char *filename)
+{
+	if (!installed)
+		return;
+
+	SDL_LockSpinlock(&memory_lock);
+
+	if (num_memory_files == max_memory_files)
+	{
+		memory_file_t *files = original_realloc(memory_files, sizeof(memory_file_t) * max_memory_files * 2);
+		if (!files)
+		{
+			SDL_UnlockSpinlock(&memory_lock);
+			return;
+		}
+
+		SDL_memset(files + max_memory_files, 0, sizeof(memory_file_t) * max_memory_files);
+		memory_files = files;
+		max_memory_files *= 2;
+	}
+
+	memory_context_t context;
+	context.file = num_memory_files++;
+	context.stage = 0;
+	memory_files[context.file].filename = filename;
+
+	SDL_UnlockSpinlock(&memory_lock);
+
+	set_memory_context(&context);
+}
+
+void set_memory_stage(const char *stage)
+{
+	if (!installed)
+		return;
+
+	SDL_LockSpinlock(&memory_lock);
+
+	/* anything past the last stage there's room for gets lumped in with "other" */
+	int index = -1;
+	for (int i = 0; i < num_memory_stages && index < 0; i++)
+		if (SDL_strcmp(memory_stage_names[i], stage) == 0)
+			index = i;
+
+	if (index < 0 && num_memory_stages < MAX_MEMORY_STAGES)
+	{
+		index = num_memory_stages++;
+		memory_stage_names[index] = stage;
+	}
+	else if (index < 0)
+	{
+		index = 0;
+	}
+
+	SDL_UnlockSpinlock(&memory_lock);
+
+	SDL_SetTLS(&memory_stage_tls, (void *)(intptr_t)index, NULL);
+}
+
+static void log_stats(const char *name, const memory_stats_t *stats)
+{
+	log_info("  %-40s %12" SDL_PRIs64 " %12.3f %12.3f", name, stats->allocations, stats->bytes / (1024.0 * 1024.0), stats->peak / (1024.0 * 1024.0));
+}
+
+static int compare_sites(const void *a, const void *b)
+{
+	const memory_site_t *left = (const memory_site_t *)a;
+	const memory_site_t *right = (const memory_site_t *)b;
+
+	/* biggest first */
+	if (left->stats.bytes != right->stats.bytes)
+		return left->stats.bytes > right->stats.bytes ? -1 : 1;
+	if (left->file != right->file)
+		return left->file - right->file;
+	return left->stage - right->stage;
+}
+
+void report_memory_tracker(void)
+{
+	if (!installed)
+		return;
+
+	/* logging allocates, so everything gets copied out first */
+	SDL_LockSpinlock(&memory_lock);
+
+	int num_files = num_memory_files;
+	int num_stages = num_memory_stages;
+	memory_stats_t total = memory_total;
+	memory_stats_t stages[MAX_MEMORY_STAGES];
+	SDL_memcpy(stages, memory_stages, sizeof(stages));
+
+	memory_file_t *files = original_malloc(sizeof(memory_file_t) * num_files);
+	memory_site_t *sites = original_malloc(sizeof(memory_site_t) * num_files * num_stages);
+	if (files && sites)
+		SDL_memcpy(files, memory_files, sizeof(memory_file_t) * num_files);
+
+	SDL_UnlockSpinlock(&memory_lock);
+
+	if (!files || !sites)
+	{
+		original_free(files);
+		original_free(sites);
+		return;
+	}
+
+	log_info("Memory: %" SDL_PRIs64 " allocations, %.3f MB allocated, %.3f MB peak, %.3f MB still live",
+		total.allocations, total.bytes / (1024.0 * 1024.0), total.peak / (1024.0 * 1024.0), total.live / (1024.0 * 1024.0));
+
+	log_info("  %-40s %12s %12s %12s", "file", "allocations", "MB", "peak MB");
+	for (int i = 0; i < num_files; i++)
+		if (files[i].stats.allocations > 0)
+			log_stats(files[i].filename, &files[i].stats);
+
+	log_info("  %-40s %12s %12s %12s", "stage", "allocations", "MB", "peak MB");
+	for (int i = 0; i < num_stages; i++)
+		if (stages[i].allocations > 0)
+			log_stats(memory_stage_names[i], &stages[i]);
+
+	/* every stage of every file, biggest first */
+	int num_sites = 0;
+	for (int file = 0; file < num_files; file++)
+	{
+		for (int stage = 0; stage < num_stages; stage++)
+		{
+			if (files[file].stages[stage].allocations == 0)
+				continue;
+
+			sites[num_sites].file = file;
+			sites[num_sites].stage = stage;
+			sites[num_sites++].stats = files[file].stages[stage];
+		}
+	}
+
+	SDL_qsort(sites, num_sites, sizeof(memory_site_t), compare_sites);
+
+	log_info("  %-40s %12s %12s %12s", "top sites", "allocations", "MB", "peak MB");
+	for (int i = 0; i < SDL_min(num_sites, MAX_MEMORY_SITES_REPORTED); i++)
+	{
+		char name[256];
+		SDL_snprintf(name, sizeof(name), "%s: %s", files[sites[i].file].filename, memory_stage_names[sites[i].stage]);
+		log_stats(name, &sites[i].stats);
+	}
+
+	original_free(files);
+	original_free(sites);
+}
@@ -0,0 +1,83 @@
+
+#ifndef _MEMORY_TRACKER_H_
+#define _MEMORY_TRACKER_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+/* which file and stage the calling thread's allocations are charged to */
+typedef struct memory_context {
+	int file;
+	int stage;
+} memory_context_t;
+
+/**
+ * \brief start counting every allocation made through SDL_malloc and friends
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note must be called before anything is allocated, since whatever was
+ * allocated before can't be freed through the tracker
+ */
+bool install_memory_tracker(void);
+
+/**
+ * \brief log how much was allocated and the peak live bytes, in total and for
+ * every file and stage
+ *
+ * \author erysdren (it/its)
+ *
+ * \note does nothing if the tracker isn't installed
+ */
+void report_memory_tracker(void);
+
+/**
+ * \brief charge the calling thread's allocations to a new file from now on
+ *
+ * \param filename name of the file, which must outlive the tracker
+ *
+ * \author erysdren (it/its)
+ *
+ * \note does nothing if the tracker isn't installed
+ */
+void set_memory_file(const char *filename);
+
+/**
+ * \brief charge the calling thread's allocations to a stage of the current file from now on
+ *
+ * \param stage name of the stage, which must outlive the tracker, like a string literal
+ *
+ * \author erysdren (it/its)
+ *
+ * \note does nothing if the tracker isn't installed
+ */
+void set_memory_stage(const char *stage);
+
+/**
+ * \brief get the file and stage the calling thread's allocations are charged to
+ *
+ * \param context filled in with the calling thread's file and stage
+ *
+ * \author erysdren (it/its)
+ */
+void get_memory_context(memory_context_t *context);
+
+/**
+ * \brief charge the calling thread's allocations to a file and stage from another thread
+ *
+ * \param context file and stage from get_memory_context()
+ *
+ * \author erysdren (it/its)
+ *
+ * \note does nothing if the tracker isn't installed
+ */
+void set_memory_context(const memory_context_t *context);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _MEMORY_TRACKER_H_ */
@@ -0,0 +1,320 @@
+
+/* for copy_file_range() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include <SDL3/SDL.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_PWRITE 1
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "output_file.h"
+#include "utils.h"
+
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+struct output_file {
+	char *filename;
+	char *temp_filename;
+	Sint64 size;
+#ifdef HAVE_PWRITE
+	int fd;
+#else
+	SDL_IOStream *io;
+	SDL_Mutex *mutex;
+#endif
+};
+
+static void free_output_file(output_file_t *file)
+{
+	SDL_free(file->filename);
+	SDL_free(file->temp_filename);
+	SDL_free(file);
+}
+
+static output_file_t *alloc_output_file(const char *filename, Sint64 size)
+{
+	output_file_t *file = SDL_calloc(1, sizeof(output_file_t));
+	if (!file)
+	{
+		log_warning("Failed to allocate output file \"%s\"", filename);
+		return NULL;
+	}
+
+	size_t len = SDL_strlen(filename) + 5;
+	file->filename = SDL_strdup(filename);
+	file->temp_filename = SDL_malloc(len);
+	if (!file->filename || !file->temp_filename)
+	{
+		log_warning("Failed to allocate output file \"%s\"", filename);
+		free_output_file(file);
+		return NULL;
+	}
+
+	SDL_snprintf(file->temp_filename, len, "%s.tmp", filename);
+	file->size = size;
+	return file;
+}
+
+#ifdef HAVE_PWRITE
+
+output_file_t *open_output_file(const char *filename, Sint64 size)
+{
+	output_file_t *file = alloc_output_file(filename, size);
+	if (!file)
+		return NULL;
+
+	file->fd = open(file->temp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (file->fd < 0)
+	{
+		log_warning("Failed to open \"%s\" for writing", file->temp_filename);
+		free_output_file(file);
+		return NULL;
+	}
+
+	/* reserve the whole file up front, falling back to a sparse one */
+	bool reserved = false;
+#ifdef __linux__
+	reserved = posix_fallocate(file->fd, 0, size) == 0;
+#endif
+	if (!reserved && ftruncate(file->fd, size) != 0)
+	{
+		log_warning("Failed to allocate %" SDL_PRIs64 " bytes for \"%s\"", size, file->temp_filename);
+		discard_output_file(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+bool write_output_file(output_file_t *file, Sint64 offset, const void *data, size_t size)
+{
+	const Uint8 *ptr = (const Uint8 *)data;
+
+	if (offset < 0 || offset + (Sint64)size > file->size)
+		return false;
+
+	while (size > 0)
+	{
+		ssize_t written = pwrite(file->fd, ptr, size, offset);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		ptr += written;
+		offset += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+bool commit_output_file(output_file_t *file)
+{
+	bool ok = close(file->fd) == 0;
+
+	if (ok)
+		ok = SDL_RenamePath(file->temp_filename, file->filename);
+
+	if (!ok)
+		SDL_RemovePath(file->temp_filename);
+
+	free_output_file(file);
+	return ok;
+}
+
+/* copy from a file descriptor without going through SDL's buffering */
+static bool copy_from_fd(output_file_t *file, Sint64 offset, int fd, Sint64 fd_offset, Sint64 size)
+{
+#ifdef __linux__
+	/* let the kernel do it, which can skip copying entirely on some filesystems */
+	off_t in = fd_offset, out = offset;
+	while (size > 0)
+	{
+		ssize_t copied = copy_file_range(fd, &in, file->fd, &out, size, 0);
+		if (copied < 0 && errno == EINTR)
+			continue;
+		else if (copied <= 0)
+			break;
+
+		size -= copied;
+	}
+
+	if (size == 0)
+		return true;
+
+	/* the rest goes the slow way */
+	offset = out;
+	fd_offset = in;
+#endif
+
+	Uint8 *buffer = SDL_malloc(SDL_min(size, COPY_BUFFER_SIZE));
+	if (!buffer)
+		return false;
+
+	bool ok = true;
+	while (ok && size > 0)
+	{
+		ssize_t got = pread(fd, buffer, SDL_min(size, COPY_BUFFER_SIZE), fd_offset);
+		if (got < 0 && errno == EINTR)
+			continue;
+
+		ok = got > 0 && write_output_file(file, offset, buffer, got);
+		offset += got;
+		fd_offset += got;
+		size -= got;
+	}
+
+	SDL_free(buffer);
+	return ok;
+}
+
+void discard_output_file(output_file_t *file)
+{
+	close(file->fd);
+	SDL_RemovePath(file->temp_filename);
+	free_output_file(file);
+}
+
+#else
+
+output_file_t *open_output_file(const char *filename, Sint64 size)
+{
+	output_file_t *file = alloc_output_file(filename, size);
+	if (!file)
+		return NULL;
+
+	file->io = SDL_IOFromFile(file->temp_filename, "wb");
+	if (!file->io)
+	{
+		log_warning("Failed to open \"%s\" for writing", file->temp_filename);
+		free_output_file(file);
+		return NULL;
+	}
+
+	/* no positioned writes here, so every write has to seek under a lock */
+	file->mutex = SDL_CreateMutex();
+	if (!file->mutex)
+	{
+		log_warning("Failed to create mutex for \"%s\"", file->temp_filename);
+		discard_output_file(file);
+		return NULL;
+	}
+
+	/* reserve the whole file up front */
+	if (size > 0 && (SDL_SeekIO(file->io, size - 1, SDL_IO_SEEK_SET) < 0 || !SDL_WriteU8(file->io, 0)))
+	{
+		log_warning("Failed to allocate %" SDL_PRIs64 " bytes for \"%s\"", size, file->temp_filename);
+		discard_output_file(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+bool write_output_file(output_file_t *file, Sint64 offset, const void *data, size_t size)
+{
+	if (offset < 0 || offset + (Sint64)size > file->size)
+		return false;
+
+	SDL_LockMutex(file->mutex);
+	bool ok = SDL_SeekIO(file->io, offset, SDL_IO_SEEK_SET) == offset && SDL_WriteIO(file->io, data, size) == size;
+	SDL_UnlockMutex(file->mutex);
+
+	return ok;
+}
+
+bool commit_output_file(output_file_t *file)
+{
+	bool ok = SDL_CloseIO(file->io);
+
+	if (ok)
+		ok = SDL_RenamePath(file->temp_filename, file->filename);
+
+	if (!ok)
+		SDL_RemovePath(file->temp_filename);
+
+	SDL_DestroyMutex(file->mutex);
+	free_output_file(file);
+	return ok;
+}
+
+void discard_output_file(output_file_t *file)
+{
+	SDL_CloseIO(file->io);
+	SDL_RemovePath(file->temp_filename);
+	SDL_DestroyMutex(file->mutex);
+	free_output_file(file);
+}
+
+#endif
+
+bool copy_to_output_file(output_file_t *file, Sint64 offset, SDL_IOStream *io, Sint64 io_offset, Sint64 size)
+{
+	if (size == 0)
+		return true;
+	else if (offset < 0 || offset + size > file->size || io_offset < 0)
+		return false;
+
+	SDL_PropertiesID props = SDL_GetIOProperties(io);
+
+	/* memory streams get written straight out of their buffer */
+	const Uint8 *mem = SDL_GetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, NULL);
+	if (mem)
+	{
+		if (io_offset + size > SDL_GetNumberProperty(props, SDL_PROP_IOSTREAM_MEMORY_SIZE_NUMBER, 0))
+			return false;
+		return write_output_file(file, offset, mem + io_offset, size);
+	}
+
+#ifdef HAVE_PWRITE
+	/* files get copied by descriptor */
+	Sint64 fd = SDL_GetNumberProperty(props, SDL_PROP_IOSTREAM_FILE_DESCRIPTOR_NUMBER, -1);
+	if (fd >= 0)
+		return copy_from_fd(file, offset, (int)fd, io_offset, size);
+#endif
+
+	/* anything else goes through a bounded buffer */
+	if (SDL_SeekIO(io, io_offset, SDL_IO_SEEK_SET) != io_offset)
+		return false;
+
+	Uint8 *buffer = SDL_malloc(SDL_min(size, COPY_BUFFER_SIZE));
+	if (!buffer)
+		return false;
+
+	bool ok = true;
+	while (ok && size > 0)
+	{
+		size_t got = SDL_ReadIO(io, buffer, SDL_min(size, COPY_BUFFER_SIZE));
+
+		ok = got > 0 && write_output_file(file, offset, buffer, got);
+		offset += got;
+		size -= got;
+	}
+
+	SDL_free(buffer);
+	return ok;
+}
+
+bool can_copy_concurrently(SDL_IOStream *io)
+{
+	SDL_PropertiesID props = SDL_GetIOProperties(io);
+
+	if (SDL_GetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, NULL))
+		return true;
+
+#ifdef HAVE_PWRITE
+	if (SDL_GetNumberProperty(props, SDL_PROP_IOSTREAM_FILE_DESCRIPTOR_NUMBER, -1) >= 0)
+		return true;
+#endif
+
+	return false;
+}
@@ -0,0 +1,96 @@
+
+#ifndef _OUTPUT_FILE_H_
+#define _OUTPUT_FILE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+typedef struct output_file output_file_t;
+
+/**
+ * \brief create a preallocated output file to be written at known offsets
+ *
+ * The data goes to a temporary file next to the final one, which only
+ * replaces it when commit_output_file() is called.
+ *
+ * \param filename final name of the file
+ * \param size final size of the file
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the output file, or NULL on error
+ */
+output_file_t *open_output_file(const char *filename, Sint64 size);
+
+/**
+ * \brief write data at an offset in an output file
+ *
+ * \param file the output file
+ * \param offset offset to write at
+ * \param data data to write
+ * \param size number of bytes to write
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note safe to call from several threads at once
+ */
+bool write_output_file(output_file_t *file, Sint64 offset, const void *data, size_t size);
+
+/**
+ * \brief copy part of an IOStream to an offset in an output file
+ *
+ * \param file the output file
+ * \param offset offset to write at
+ * \param io the IOStream to copy from
+ * \param io_offset offset in the IOStream to copy from
+ * \param size number of bytes to copy
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note memory streams are written straight from their buffer and files are
+ * copied by descriptor, so only other streams need a bounce buffer
+ * \note may move the position of the IOStream
+ */
+bool copy_to_output_file(output_file_t *file, Sint64 offset, SDL_IOStream *io, Sint64 io_offset, Sint64 size);
+
+/**
+ * \brief check if copy_to_output_file() can copy from an IOStream on several threads at once
+ *
+ * \param io the IOStream to copy from
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true if copies never move the position of the IOStream
+ */
+bool can_copy_concurrently(SDL_IOStream *io);
+
+/**
+ * \brief close an output file and atomically move it into place
+ *
+ * \param file the output file, which is always freed
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ */
+bool commit_output_file(output_file_t *file);
+
+/**
+ * \brief close an output file and delete it without touching the final file
+ *
+ * \param file the output file, which is always freed
+ *
+ * \author erysdren (it/its)
+ */
+void discard_output_file(output_file_t *file);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _OUTPUT_FILE_H_ */
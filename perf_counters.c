@@ -0,0 +1,359 @@
+#include <SDL3/SDL.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_counters.h"
+#include "utils.h"
+
+#define PERF_MAX_TARGET 64
+
+/* every sample with the same stage and target gets added to the same row */
+typedef struct perf_row {
+	const char *stage;
+	char target[PERF_MAX_TARGET];
+	Sint64 samples;
+	Sint64 bytes;
+	Uint64 totals[PERF_NUM_COUNTERS];
+} perf_row_t;
+
+static const char *perf_counter_names[PERF_NUM_COUNTERS] = {
+	"cycles", "instructions", "cache_misses", "branch_misses", "page_faults"
+};
+
+/* set and cleared while nothing else is running, so checking it needs no lock */
+static bool counting;
+static char *perf_filename;
+static SDL_SpinLock perf_lock;
+static perf_row_t *perf_rows;
+static int num_perf_rows;
+static int max_perf_rows;
+static SDL_AtomicInt perf_available[PERF_NUM_COUNTERS];
+
+#ifdef __linux__
+
+typedef struct perf_thread {
+	int leader;
+	int num_open;
+	int fds[PERF_NUM_COUNTERS];
+	perf_counter_t order[PERF_NUM_COUNTERS]; /* which counter each value read from the group belongs to */
+} perf_thread_t;
+
+static const struct {
+	Uint32 type;
+	Uint64 config;
+} perf_events[PERF_NUM_COUNTERS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+};
+
+static SDL_TLSID perf_tls;
+static SDL_AtomicInt perf_warned;
+
+static void close_perf_thread(void *value)
+{
+	perf_thread_t *thread = (perf_thread_t *)value;
+
+	for (int i = 0; i < thread->num_open; i++)
+		close(thread->fds[i]);
+
+	SDL_free(thread);
+}
+
+/* each thread opens its own group the first time it needs it, and it's closed when the thread exits */
+static perf_thread_t *get_perf_thread(void)
+{
+	perf_thread_t *thread = (perf_thread_t *)SDL_GetTLS(&perf_tls);
+	if (thread)
+		return thread;
+
+	/* without one the sample just isn't counted, and it's tried again next time */
+	thread = SDL_calloc(1, sizeof(perf_thread_t));
+	if (!thread)
+		return NULL;
+
+	thread->leader = -1;
+
+	int error = 0;
+	for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+	{
+		struct perf_event_attr attr;
+		SDL_zero(attr);
+		attr.size = sizeof(attr);
+		attr.type = perf_events[i].type;
+		attr.config = perf_events[i].config;
+		attr.read_format = PERF_FORMAT_GROUP;
+
+		/* user space only, which is all that's allowed by default */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		/* containers and virtual machines often don't have some or all of them */
+		int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, thread->leader, 0);
+		if (fd < 0)
+		{
+			error = errno;
+			continue;
+		}
+
+		if (thread->leader < 0)
+			thread->leader = fd;
+
+		thread->fds[thread->num_open] = fd;
+		thread->order[thread->num_open++] = (perf_counter_t)i;
+		SDL_SetAtomicInt(&perf_available[i], 1);
+	}
+
+	if (error != 0 && SDL_CompareAndSwapAtomicInt(&perf_warned, 0, 1))
+		log_warning("Some performance counters aren't available (%s), so they'll be left out", strerror(error));
+
+	SDL_SetTLS(&perf_tls, thread, close_perf_thread);
+
+	return thread;
+}
+
+/* the whole group is read in one go */
+static bool read_perf_thread(perf_thread_t *thread, Uint64 *values)
+{
+	if (!thread || thread->num_open == 0)
+		return false;
+
+	Uint64 data[1 + PERF_NUM_COUNTERS];
+	ssize_t size = read(thread->leader, data, sizeof(data));
+	if (size < (ssize_t)(sizeof(Uint64) * (1 + thread->num_open)) || data[0] != (Uint64)thread->num_open)
+		return false;
+
+	for (int i = 0; i < thread->num_open; i++)
+		values[thread->order[i]] = data[1 + i];
+
+	return true;
+}
+
+#endif
+
+bool open_perf_counters(const char *filename)
+{
+	if (counting)
+		return false;
+
+#ifdef __linux__
+	perf_filename = SDL_strcmp(filename, "-") == 0 ? NULL : SDL_strdup(filename);
+	counting = true;
+
+	return true;
+#else
+	log_warning("Performance counters are only available on Linux");
+
+	return false;
+#endif
+}
+
+void begin_perf_sample(perf_sample_t *sample)
+{
+	sample->counting = false;
+
+	if (!counting)
+		return;
+
+#ifdef __linux__
+	SDL_zeroa(sample->values);
+	sample->counting = read_perf_thread(get_perf_thread(), sample->values);
+#endif
+}
+
+void end_perf_sample(const perf_sample_t *sample, const char *stage, Sint64 bytes, SDL_PRINTF_FORMAT_STRING const char *fmt, ...)
+{
+	if (!sample->counting)
+		return;
+
+#ifdef __linux__
+	Uint64 values[PERF_NUM_COUNTERS];
+	SDL_zeroa(values);
+	if (!read_perf_thread((perf_thread_t *)SDL_GetTLS(&perf_tls), values))
+		return;
+
+	char target[PERF_MAX_TARGET];
+	va_list ap;
+	va_start(ap, fmt);
+	SDL_vsnprintf(target, sizeof(target), fmt, ap);
+	va_end(ap);
+
+	SDL_LockSpinlock(&perf_lock);
+
+	/* there's only ever a few hundred rows */
+	perf_row_t *row = NULL;
+	for (int i = 0; i < num_perf_rows && !row; i++)
+		if (SDL_strcmp(perf_rows[i].stage, stage) == 0 && SDL_strcmp(perf_rows[i].target, target) == 0)
+			row = &perf_rows[i];
+
+	if (!row)
+	{
+		if (num_perf_rows == max_perf_rows)
+		{
+			/* the rows so far are kept if it can't grow, only this sample is lost */
+			int max_rows = SDL_max(max_perf_rows * 2, 64);
+			perf_row_t *rows = SDL_realloc(perf_rows, sizeof(perf_row_t) * max_rows);
+			if (!rows)
+			{
+				SDL_UnlockSpinlock(&perf_lock);
+				return;
+			}
+
+			perf_rows = rows;
+			max_perf_rows = max_rows;
+		}
+
+		row = &perf_rows[num_perf_rows++];
+		SDL_zerop(row);
+		row->stage = stage;
+		SDL_strlcpy(row->target, target, sizeof(row->target));
+	}
+
+	row->samples++;
+	row->bytes += SDL_max(bytes, 0);
+	for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+		row->totals[i] += values[i] - sample->values[i];
+
+	SDL_UnlockSpinlock(&perf_lock);
+#endif
+}
+
+/* the first counter that's available, to sort by */
+static int get_sort_counter(void)
+{
+	for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+		if (SDL_GetAtomicInt(&perf_available[i]))
+			return i;
+	return 0;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+	const perf_row_t *left = (const perf_row_t *)a;
+	const perf_row_t *right = (const perf_row_t *)b;
+	int counter = get_sort_counter();
+
+	/* grouped by stage, most expensive first */
+	int stage = SDL_strcmp(left->stage, right->stage);
+	if (stage != 0)
+		return stage;
+	if (left->totals[counter] != right->totals[counter])
+		return left->totals[counter] > right->totals[counter] ? -1 : 1;
+	return SDL_strcmp(left->target, right->target);
+}
+
+static void log_perf_table(void)
+{
+	bool cycles = SDL_GetAtomicInt(&perf_available[PERF_COUNTER_CYCLES]);
+	bool instructions = SDL_GetAtomicInt(&perf_available[PERF_COUNTER_INSTRUCTIONS]);
+	char line[512];
+	int len;
+
+	len = SDL_snprintf(line, sizeof(line), "%-12s %-20s %8s %10s", "stage", "target", "samples", "MB");
+	for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+		if (SDL_GetAtomicInt(&perf_available[i]))
+			len += SDL_snprintf(line + len, sizeof(line) - len, " %15s", perf_counter_names[i]);
+	if (cycles && instructions)
+		len += SDL_snprintf(line + len, sizeof(line) - len, " %6s", "ipc");
+	if (cycles)
+		len += SDL_snprintf(line + len, sizeof(line) - len, " %10s", "cycles/B");
+	log_info("%s", line);
+
+	for (int row = 0; row < num_perf_rows; row++)
+	{
+		const perf_row_t *r = &perf_rows[row];
+
+		len = SDL_snprintf(line, sizeof(line), "%-12s %-20s %8" SDL_PRIs64 " %10.3f", r->stage, r->target, r->samples, r->bytes / (1024.0 * 1024.0));
+		for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+			if (SDL_GetAtomicInt(&perf_available[i]))
+				len += SDL_snprintf(line + len, sizeof(line) - len, " %15" SDL_PRIu64, r->totals[i]);
+		if (cycles && instructions)
+			len += SDL_snprintf(line + len, sizeof(line) - len, " %6.2f", r->totals[PERF_COUNTER_CYCLES] > 0 ? (double)r->totals[PERF_COUNTER_INSTRUCTIONS] / r->totals[PERF_COUNTER_CYCLES] : 0.0);
+		if (cycles)
+			len += SDL_snprintf(line + len, sizeof(line) - len, " %10.2f", r->bytes > 0 ? (double)r->totals[PERF_COUNTER_CYCLES] / r->bytes : 0.0);
+		log_info("%s", line);
+	}
+}
+
+/* counters that weren't available are left empty */
+static bool write_perf_csv(const char *filename)
+{
+	SDL_IOStream *io = SDL_IOFromFile(filename, "wb");
+	if (!io)
+	{
+		log_warning("Failed to open \"%s\" for writing", filename);
+		return false;
+	}
+
+	SDL_IOprintf(io, "stage,target,samples,bytes");
+	for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+		SDL_IOprintf(io, ",%s", perf_counter_names[i]);
+	SDL_IOprintf(io, "\n");
+
+	for (int row = 0; row < num_perf_rows; row++)
+	{
+		const perf_row_t *r = &perf_rows[row];
+
+		SDL_IOprintf(io, "%s,\"", r->stage);
+		for (const char *c = r->target; *c; c++)
+			SDL_WriteIO(io, *c == '"' ? "\"\"" : c, *c == '"' ? 2 : 1);
+		SDL_IOprintf(io, "\",%" SDL_PRIs64 ",%" SDL_PRIs64, r->samples, r->bytes);
+
+		for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+		{
+			if (SDL_GetAtomicInt(&perf_available[i]))
+				SDL_IOprintf(io, ",%" SDL_PRIu64, r->totals[i]);
+			else
+				SDL_IOprintf(io, ",");
+		}
+
+		SDL_IOprintf(io, "\n");
+	}
+
+	bool ok = SDL_CloseIO(io);
+	if (!ok)
+		log_warning("Failed to write \"%s\"", filename);
+
+	return ok;
+}
+
+bool close_perf_counters(void)
+{
+	if (!counting)
+		return true;
+
+	counting = false;
+
+	bool ok = true;
+	if (num_perf_rows == 0)
+	{
+		log_warning("No performance counters were available");
+	}
+	else
+	{
+		SDL_qsort(perf_rows, num_perf_rows, sizeof(perf_row_t), compare_rows);
+
+		if (perf_filename)
+			ok = write_perf_csv(perf_filename);
+		else
+			log_perf_table();
+	}
+
+	/* clean up */
+	SDL_free(perf_rows);
+	SDL_free(perf_filename);
+	perf_rows = NULL;
+	perf_filename = NULL;
+	num_perf_rows = 0;
+	max_perf_rows = 0;
+
+	return ok;
+}
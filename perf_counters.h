@@ -0,0 +1,79 @@
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+typedef enum perf_counter {
+	PERF_COUNTER_CYCLES,
+	PERF_COUNTER_INSTRUCTIONS,
+	PERF_COUNTER_CACHE_MISSES,
+	PERF_COUNTER_BRANCH_MISSES,
+	PERF_COUNTER_PAGE_FAULTS,
+	PERF_NUM_COUNTERS
+} perf_counter_t;
+
+typedef struct perf_sample {
+	bool counting;
+	Uint64 values[PERF_NUM_COUNTERS];
+} perf_sample_t;
+
+/**
+ * \brief start counting cycles, instructions, cache misses, branch misses and
+ * page faults around every sample, to be reported by close_perf_counters()
+ *
+ * \param filename file to write the totals to as CSV, or "-" to only log them as a table
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note must be called before any threads start converting
+ * \note only Linux has counters, and they're opened by each thread the first
+ * time it needs them, so any that can't be opened are left out of the report
+ */
+bool open_perf_counters(const char *filename);
+
+/**
+ * \brief stop counting and report the totals for every stage and target
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success or if nothing was being counted, false on error
+ *
+ * \note must be called after every thread has finished converting
+ */
+bool close_perf_counters(void);
+
+/**
+ * \brief read the calling thread's counters at the start of a sample
+ *
+ * \param sample sample to start, which doesn't count anything if counters are off or unavailable
+ *
+ * \author erysdren (it/its)
+ */
+void begin_perf_sample(perf_sample_t *sample);
+
+/**
+ * \brief read the calling thread's counters again and add the difference to a stage's totals
+ *
+ * \param sample sample started by begin_perf_sample() on the same thread
+ * \param stage what was done, which must outlive the counters, like a string literal
+ * \param bytes number of bytes it was done to, for the per byte figures
+ * \param fmt printf style format string for what kind of thing it was done to
+ *
+ * \author erysdren (it/its)
+ *
+ * \note samples with the same stage and target are added together, so the target
+ * should name a kind of thing, like a lump, rather than every single one
+ * \note safe to call from several threads at once
+ */
+void end_perf_sample(const perf_sample_t *sample, const char *stage, Sint64 bytes, SDL_PRINTF_FORMAT_STRING const char *fmt, ...) SDL_PRINTF_VARARG_FUNC(4);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _PERF_COUNTERS_H_ */
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# generates lump_schemas.h from the struct types in kaitai/bsp360.ksy
+# usage: python3 python/gen_lump_schemas.py kaitai/bsp360.ksy lump_schemas.h
+
+import sys
+import yaml
+
+# ksy types that get a schema, in the order they're written out
+SCHEMA_TYPES = [
+	"node",
+	"face",
+	"leaf",
+	"areaportal",
+	"disp_info",
+	"leaf_water_data",
+	"primitive",
+	"overlay",
+	"static_prop_v4",
+	"static_prop_v5",
+	"static_prop_v6",
+	"static_prop_v7",
+	"static_prop_v8",
+	"static_prop_v9",
+	"static_prop_v10",
+	"static_prop_v11",
+	"detail_sprite",
+	"detail_object",
+]
+
+PRIMITIVE_WIDTHS = {
+	"u1": 1, "s1": 1,
+	"u2": 2, "s2": 2,
+	"u4": 4, "s4": 4, "f4": 4,
+	"u8": 8, "s8": 8, "f8": 8,
+}
+
+def get_field_widths(types, name):
+	widths = []
+	for field in types[name]["seq"]:
+		count = int(field.get("repeat-expr", 1)) if field.get("repeat") == "expr" else 1
+		if "size" in field:
+			# raw bytes, never swapped
+			one = [1] * int(field["size"])
+		elif field["type"] in PRIMITIVE_WIDTHS:
+			one = [PRIMITIVE_WIDTHS[field["type"]]]
+		elif field["type"] in types:
+			one = get_field_widths(types, field["type"])
+		else:
+			raise ValueError("%s.%s: unsupported type %s" % (name, field["id"], field["type"]))
+		widths += one * count
+	return widths
+
+def check_alignment(name, widths):
+	offset = 0
+	for width in widths:
+		if offset % width != 0:
+			raise ValueError("%s: %d byte field at offset %d isn't naturally aligned" % (name, width, offset))
+		offset += width
+	return offset
+
+ksy = yaml.safe_load(open(sys.argv[1]))
+types = ksy["types"]
+
+out = open(sys.argv[2], "w")
+out.write("\n/* generated by python/gen_lump_schemas.py from kaitai/bsp360.ksy, do not edit */\n\n")
+out.write("#ifndef _LUMP_SCHEMAS_H_\n#define _LUMP_SCHEMAS_H_\n\n")
+out.write("#include \"byteswap.h\"\n")
+
+for name in SCHEMA_TYPES:
+	widths = get_field_widths(types, name)
+	size = check_alignment(name, widths)
+	out.write("\n#define SCHEMA_%s_SIZE %d\n" % (name.upper(), size))
+	out.write("static const Uint8 %s_fields[%d] = {" % (name, len(widths)))
+	for i, width in enumerate(widths):
+		out.write(("\n\t" if i % 16 == 0 else " ") + "%d," % width)
+	out.write("\n};\n")
+	out.write("static const struct_schema_t %s_schema = { %s_fields, %d, SCHEMA_%s_SIZE };\n" % (name, name, len(widths), name.upper()))
+
+out.write("\n#endif /* _LUMP_SCHEMAS_H_ */\n")
+out.close()
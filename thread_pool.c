@@ -0,0 +1,87 @@
+
+#include <SDL3/SDL.h>
+
+#include "memory_tracker.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+#define MAX_WORKERS 256
+
+typedef struct job_pool {
+	int num_jobs;
+	const int *order;
+	job_func_t func;
+	void *userdata;
+	memory_context_t memory_context;
+	SDL_AtomicInt next_job;
+} job_pool_t;
+
+typedef struct job_worker {
+	job_pool_t *pool;
+	int thread;
+} job_worker_t;
+
+static int job_worker_main(void *data)
+{
+	job_worker_t *worker = (job_worker_t *)data;
+	job_pool_t *pool = worker->pool;
+
+	/* allocations are charged to whatever the calling thread was doing */
+	if (worker->thread != 0)
+		set_memory_context(&pool->memory_context);
+
+	/* grab jobs until there are none left */
+	while (1)
+	{
+		int next = SDL_AddAtomicInt(&pool->next_job, 1);
+		if (next >= pool->num_jobs)
+			break;
+
+		pool->func(pool->userdata, pool->order ? pool->order[next] : next, worker->thread);
+	}
+
+	return 0;
+}
+
+int get_num_workers(int requested)
+{
+	if (requested <= 0)
+		requested = SDL_GetNumLogicalCPUCores();
+	return SDL_clamp(requested, 1, MAX_WORKERS);
+}
+
+void run_jobs(int num_jobs, int num_threads, const int *order, job_func_t func, void *userdata)
+{
+	job_pool_t pool;
+	pool.num_jobs = num_jobs;
+	pool.order = order;
+	pool.func = func;
+	pool.userdata = userdata;
+	get_memory_context(&pool.memory_context);
+	SDL_SetAtomicInt(&pool.next_job, 0);
+
+	/* no point in spawning more threads than there are jobs */
+	num_threads = SDL_clamp(num_threads, 1, MAX_WORKERS);
+	if (num_threads > num_jobs)
+		num_threads = num_jobs;
+
+	/* the calling thread is always worker 0 */
+	job_worker_t workers[MAX_WORKERS];
+	SDL_Thread *threads[MAX_WORKERS];
+	for (int i = 1; i < num_threads; i++)
+	{
+		workers[i].pool = &pool;
+		workers[i].thread = i;
+		threads[i] = SDL_CreateThread(job_worker_main, "job_worker", &workers[i]);
+		if (!threads[i])
+			log_warning("Failed to create worker thread %d", i);
+	}
+
+	workers[0].pool = &pool;
+	workers[0].thread = 0;
+	job_worker_main(&workers[0]);
+
+	for (int i = 1; i < num_threads; i++)
+		if (threads[i])
+			SDL_WaitThread(threads[i], NULL);
+}
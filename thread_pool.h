@@ -0,0 +1,48 @@
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+/**
+ * \brief function run for each job
+ *
+ * \param userdata the userdata pointer passed to run_jobs()
+ * \param job index of the job to run
+ * \param thread index of the worker running the job, from 0 to num_threads - 1
+ */
+typedef void (*job_func_t)(void *userdata, int job, int thread);
+
+/**
+ * \brief get the number of worker threads to use for a requested count
+ *
+ * \param requested requested number of threads, or <= 0 for one per logical core
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the number of worker threads to use, always at least 1
+ */
+int get_num_workers(int requested);
+
+/**
+ * \brief run a number of jobs on a pool of worker threads and wait for them all to finish
+ *
+ * \param num_jobs number of jobs to run
+ * \param num_threads maximum number of threads to run jobs on, including the calling thread
+ * \param order optional array of num_jobs job indices giving the order jobs are started in, or NULL
+ * \param func function to call for each job
+ * \param userdata pointer passed to func
+ *
+ * \author erysdren (it/its)
+ *
+ * \note with 1 thread all jobs run on the calling thread in order
+ */
+void run_jobs(int num_jobs, int num_threads, const int *order, job_func_t func, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _THREAD_POOL_H_ */
@@ -0,0 +1,219 @@
+#include <SDL3/SDL.h>
+
+#include "trace.h"
+#include "utils.h"
+
+#define TRACE_BLOCK_EVENTS 4096
+
+typedef struct trace_event {
+	Uint64 start;
+	Uint64 end;
+	SDL_ThreadID thread;
+	const char *name;
+	char *target;
+	Sint64 bytes_in;
+	Sint64 bytes_out;
+} trace_event_t;
+
+/* events are never moved once recorded, so a full block just gets a new one in front */
+typedef struct trace_block {
+	struct trace_block *next;
+	int num_events;
+	trace_event_t events[TRACE_BLOCK_EVENTS];
+} trace_block_t;
+
+/* set and cleared while nothing else is running, so checking it needs no lock */
+static bool tracing;
+static SDL_IOStream *trace_io;
+static SDL_ThreadID trace_main_thread;
+static SDL_SpinLock trace_lock;
+static trace_block_t *trace_blocks;
+
+bool open_trace(const char *filename)
+{
+	if (tracing)
+		return false;
+
+	trace_io = SDL_IOFromFile(filename, "wb");
+	if (!trace_io)
+	{
+		log_warning("Failed to open \"%s\" for writing", filename);
+		return false;
+	}
+
+	trace_main_thread = SDL_GetCurrentThreadID();
+	tracing = true;
+
+	return true;
+}
+
+Uint64 begin_trace_span(void)
+{
+	if (!tracing)
+		return 0;
+
+	/* 0 means nothing is being traced */
+	return SDL_max(SDL_GetTicksNS(), 1);
+}
+
+void end_trace_span(Uint64 start, const char *name, Sint64 bytes_in, Sint64 bytes_out, SDL_PRINTF_FORMAT_STRING const char *fmt, ...)
+{
+	if (start == 0)
+		return;
+
+	trace_event_t event;
+	event.start = start;
+	event.end = SDL_GetTicksNS();
+	event.thread = SDL_GetCurrentThreadID();
+	event.name = name;
+	event.bytes_in = bytes_in;
+	event.bytes_out = bytes_out;
+
+	/* formatted outside the lock, it's the slowest part */
+	va_list ap;
+	va_start(ap, fmt);
+	if (SDL_vasprintf(&event.target, fmt, ap) < 0)
+		event.target = NULL;
+	va_end(ap);
+
+	SDL_LockSpinlock(&trace_lock);
+
+	if (!trace_blocks || trace_blocks->num_events == TRACE_BLOCK_EVENTS)
+	{
+		/* no room for it, so the event is dropped rather than stopping the conversion */
+		trace_block_t *block = SDL_malloc(sizeof(trace_block_t));
+		if (!block)
+		{
+			SDL_UnlockSpinlock(&trace_lock);
+			SDL_free(event.target);
+			return;
+		}
+
+		block->next = trace_blocks;
+		block->num_events = 0;
+		trace_blocks = block;
+	}
+
+	trace_blocks->events[trace_blocks->num_events++] = event;
+
+	SDL_UnlockSpinlock(&trace_lock);
+}
+
+static void write_json_string(SDL_IOStream *io, const char *s)
+{
+	SDL_WriteIO(io, "\"", 1);
+
+	for (; s && *s; s++)
+	{
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			SDL_IOprintf(io, "\\%c", c);
+		else if (c < 0x20)
+			SDL_IOprintf(io, "\\u%04x", c);
+		else
+			SDL_WriteIO(io, s, 1);
+	}
+
+	SDL_WriteIO(io, "\"", 1);
+}
+
+static int compare_events(const void *a, const void *b)
+{
+	const trace_event_t *left = *(const trace_event_t **)a;
+	const trace_event_t *right = *(const trace_event_t **)b;
+
+	/* grouped by thread, then in the order they started */
+	if (left->thread != right->thread)
+		return left->thread < right->thread ? -1 : 1;
+	if (left->start != right->start)
+		return left->start < right->start ? -1 : 1;
+	return 0;
+}
+
+bool close_trace(void)
+{
+	if (!tracing)
+		return true;
+
+	tracing = false;
+
+	int num_events = 0;
+	for (trace_block_t *block = trace_blocks; block; block = block->next)
+		num_events += block->num_events;
+
+	bool ok = false;
+	trace_event_t **events = SDL_malloc(sizeof(trace_event_t *) * SDL_max(num_events, 1));
+	if (!events)
+	{
+		log_warning("Failed to allocate %d trace events", num_events);
+		SDL_CloseIO(trace_io);
+		goto cleanup;
+	}
+
+	int num_sorted = 0;
+	for (trace_block_t *block = trace_blocks; block; block = block->next)
+		for (int i = 0; i < block->num_events; i++)
+			events[num_sorted++] = &block->events[i];
+
+	SDL_qsort(events, num_events, sizeof(trace_event_t *), compare_events);
+
+	/* times start from the first span */
+	Uint64 first = SDL_MAX_UINT64;
+	for (int i = 0; i < num_events; i++)
+		first = SDL_min(first, events[i]->start);
+
+	SDL_IOprintf(trace_io, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	SDL_IOprintf(trace_io, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}");
+
+	/* thread ids are huge, so every worker gets numbered instead */
+	int tid = 0;
+	int num_workers = 0;
+	for (int i = 0; i < num_events; i++)
+	{
+		trace_event_t *event = events[i];
+
+		if (i == 0 || event->thread != events[i - 1]->thread)
+		{
+			if (event->thread == trace_main_thread)
+				tid = 0;
+			else
+			{
+				tid = ++num_workers;
+				SDL_IOprintf(trace_io, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}", tid, tid);
+			}
+		}
+
+		SDL_IOprintf(trace_io, ",\n{\"name\":");
+		write_json_string(trace_io, event->name);
+		SDL_IOprintf(trace_io, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"target\":", tid,
+			(event->start - first) / 1000.0, (event->end - event->start) / 1000.0);
+		write_json_string(trace_io, event->target);
+		if (event->bytes_in >= 0)
+			SDL_IOprintf(trace_io, ",\"bytes_in\":%" SDL_PRIs64, event->bytes_in);
+		if (event->bytes_out >= 0)
+			SDL_IOprintf(trace_io, ",\"bytes_out\":%" SDL_PRIs64, event->bytes_out);
+		SDL_IOprintf(trace_io, "}}");
+	}
+
+	SDL_IOprintf(trace_io, "\n]}\n");
+
+	ok = SDL_CloseIO(trace_io);
+	if (!ok)
+		log_warning("Failed to write trace");
+
+	/* clean up */
+cleanup:
+	SDL_free(events);
+	while (trace_blocks)
+	{
+		trace_block_t *next = trace_blocks->next;
+		for (int i = 0; i < trace_blocks->num_events; i++)
+			SDL_free(trace_blocks->events[i].target);
+		SDL_free(trace_blocks);
+		trace_blocks = next;
+	}
+
+	trace_io = NULL;
+
+	return ok;
+}
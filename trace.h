@@ -0,0 +1,62 @@
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+/**
+ * \brief start recording spans, to be written to a file by close_trace()
+ *
+ * \param filename file to write the trace to, in Chrome's trace event format
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note must be called before any threads start converting
+ */
+bool open_trace(const char *filename);
+
+/**
+ * \brief stop recording spans and write every recorded span out
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success or if nothing was being traced, false on error
+ *
+ * \note must be called after every thread has finished converting
+ */
+bool close_trace(void);
+
+/**
+ * \brief get the start of a span, to pass to end_trace_span() once it's done
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the current time, or 0 if nothing is being traced
+ */
+Uint64 begin_trace_span(void);
+
+/**
+ * \brief record a span that started at begin_trace_span() and ends now
+ *
+ * \param start value returned by begin_trace_span()
+ * \param name what was done, which must outlive the trace, like a string literal
+ * \param bytes_in number of bytes read, or -1 if it doesn't apply
+ * \param bytes_out number of bytes written, or -1 if it doesn't apply
+ * \param fmt printf style format string for what it was done to
+ *
+ * \author erysdren (it/its)
+ *
+ * \note does nothing if start is 0, so the target is only formatted while tracing
+ * \note safe to call from several threads at once
+ */
+void end_trace_span(Uint64 start, const char *name, Sint64 bytes_in, Sint64 bytes_out, SDL_PRINTF_FORMAT_STRING const char *fmt, ...) SDL_PRINTF_VARARG_FUNC(5);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _TRACE_H_ */
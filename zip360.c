@@ -0,0 +1,1567 @@
+
+#include <SDL3/SDL.h>
+
+#include "zip360.h"
+#include "decompress_lzma.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "utils.h"
+
+#define ZIP_MAGIC_SIGNATURE 0x4b50
+#define ZIP_MAGIC_CENTRAL_DIR_ENTRY 0x0201
+#define ZIP_MAGIC_LOCAL_FILE_HEADER 0x0403
+#define ZIP_MAGIC_CENTRAL_DIR_END 0x0605
+#define ZIP_MAGIC_ZIP64_CENTRAL_DIR_END 0x0606
+#define ZIP_MAGIC_ZIP64_CENTRAL_DIR_LOCATOR 0x0706
+
+#define ZIP_COMPRESSION_STORED 0
+#define ZIP_COMPRESSION_LZMA 14
+
+/* general purpose flag bit 1 means an lzma entry ends with an end marker */
+#define ZIP_FLAG_LZMA_END_MARKER (1 << 1)
+
+/* payload padding goes in one of these, the same id zipalign uses */
+#define ZIP_EXTRA_ALIGNMENT 0xD935
+#define ZIP_EXTRA_ALIGNMENT_MIN_SIZE 6
+
+/* 64-bit sizes and offsets, for fields that hold 0xFFFFFFFF instead */
+#define ZIP_EXTRA_ZIP64 0x0001
+#define ZIP_ZIP64_MARKER_16 SDL_MAX_UINT16
+#define ZIP_ZIP64_MARKER_32 SDL_MAX_UINT32
+
+/* version needed to extract, times ten */
+#define ZIP_VERSION_STORED 10
+#define ZIP_VERSION_ZIP64 45
+#define ZIP_VERSION_LZMA 63
+
+typedef struct zip_central_dir_end {
+	Uint16 signature;
+	Uint16 type;
+	Uint32 disk;
+	Uint32 disk_with_central_dir;
+	Uint64 num_entries_this_disk;
+	Uint64 num_entries_total;
+	Uint64 len_directory;
+	Uint64 ofs_directory;
+	Uint16 len_comment;
+	char *comment;
+} zip_central_dir_end_t;
+
+typedef struct zip_local_file_header {
+	Uint16 signature;
+	Uint16 type;
+	Uint16 version_needed;
+	Uint16 flags;
+	Uint16 compression;
+	Uint16 file_time;
+	Uint16 file_date;
+	Uint32 crc32;
+	Uint64 len_file_compressed;
+	Uint64 len_file_uncompressed;
+	Uint16 len_filename;
+	Uint16 len_extra;
+	char *filename;
+	void *extra;
+	void *data;
+} zip_local_file_header_t;
+
+typedef struct zip_central_dir_entry {
+	Uint16 signature;
+	Uint16 type;
+	Uint16 version_made_with;
+	Uint16 version_needed;
+	Uint16 flags;
+	Uint16 compression;
+	Uint16 file_time;
+	Uint16 file_date;
+	Uint32 crc32;
+	Uint64 len_file_compressed;
+	Uint64 len_file_uncompressed;
+	Uint16 len_filename;
+	Uint16 len_extra;
+	Uint16 len_comment;
+	Uint32 disk;
+	Uint16 internal_attributes;
+	Uint32 external_attributes;
+	Uint64 ofs_local_file_header;
+	char *filename;
+	void *extra;
+	char *comment;
+	zip_local_file_header_t local_file_header;
+	void *data;
+	Sint64 ofs_data;
+	Uint16 len_padding;
+	bool generated;
+} zip_central_dir_entry_t;
+
+#define ZIP_LOCAL_FILE_HEADER_SIZE 30
+#define ZIP_CENTRAL_DIR_ENTRY_SIZE 46
+#define ZIP_CENTRAL_DIR_END_SIZE 22
+#define ZIP_ZIP64_CENTRAL_DIR_END_SIZE 56
+#define ZIP_ZIP64_CENTRAL_DIR_LOCATOR_SIZE 20
+
+/* the end record can have up to a 64k comment after it */
+#define ZIP_CENTRAL_DIR_END_SEARCH_SIZE (ZIP_CENTRAL_DIR_END_SIZE + SDL_MAX_UINT16)
+
+/* big endian, unlike everything else in the zip */
+#define ZIP_PRELOAD_SECTION_NAME "__preload_section.pre"
+#define ZIP_PRELOAD_SECTION_VERSION 3
+#define ZIP_PRELOAD_SECTION_HEADER_SIZE 16
+#define ZIP_PRELOAD_DIRECTORY_ENTRY_SIZE 8
+
+typedef struct zip_preload_directory_entry {
+	Uint32 length;
+	Uint32 offset;
+} zip_preload_directory_entry_t;
+
+typedef struct zip_preload_section {
+	Uint32 version;
+	Uint32 num_directory_entries;
+	Uint32 num_preload_directory_entries;
+	Uint32 alignment;
+	zip_preload_directory_entry_t *preload_directory_entries;
+	Uint16 *preload_directory_indices;
+} zip_preload_section_t;
+
+struct zip360 {
+	SDL_IOStream *io;
+	arena_t *arena;
+	const char *name;
+	zip_central_dir_end_t central_dir_end;
+	zip_central_dir_entry_t *entries;
+	char *string_pool;
+	Sint32 *hash_table;
+	Uint32 hash_mask;
+	zip_preload_section_t *preload_section;
+	int preload_index;
+	int *order;
+	int num_order;
+	Uint32 alignment;
+	Sint64 output_size;
+};
+
+static Uint16 get_u16le(const Uint8 *ptr)
+{
+	Uint16 value;
+	SDL_memcpy(&value, ptr, 2);
+	return SDL_Swap16LE(value);
+}
+
+static Uint32 get_u32le(const Uint8 *ptr)
+{
+	Uint32 value;
+	SDL_memcpy(&value, ptr, 4);
+	return SDL_Swap32LE(value);
+}
+
+static Uint64 get_u64le(const Uint8 *ptr)
+{
+	Uint64 value;
+	SDL_memcpy(&value, ptr, 8);
+	return SDL_Swap64LE(value);
+}
+
+static Uint16 get_u16be(const Uint8 *ptr)
+{
+	Uint16 value;
+	SDL_memcpy(&value, ptr, 2);
+	return SDL_Swap16BE(value);
+}
+
+static Uint32 get_u32be(const Uint8 *ptr)
+{
+	Uint32 value;
+	SDL_memcpy(&value, ptr, 4);
+	return SDL_Swap32BE(value);
+}
+
+/* the fixed part only, the variable fields are handled by open_zip360() */
+static void parse_central_dir_entry(const Uint8 *ptr, zip_central_dir_entry_t *entry)
+{
+	entry->signature = get_u16le(ptr + 0);
+	entry->type = get_u16le(ptr + 2);
+	entry->version_made_with = get_u16le(ptr + 4);
+	entry->version_needed = get_u16le(ptr + 6);
+	entry->flags = get_u16le(ptr + 8);
+	entry->compression = get_u16le(ptr + 10);
+	entry->file_time = get_u16le(ptr + 12);
+	entry->file_date = get_u16le(ptr + 14);
+	entry->crc32 = get_u32le(ptr + 16);
+	entry->len_file_compressed = get_u32le(ptr + 20);
+	entry->len_file_uncompressed = get_u32le(ptr + 24);
+	entry->len_filename = get_u16le(ptr + 28);
+	entry->len_extra = get_u16le(ptr + 30);
+	entry->len_comment = get_u16le(ptr + 32);
+	entry->disk = get_u16le(ptr + 34);
+	entry->internal_attributes = get_u16le(ptr + 36);
+	entry->external_attributes = get_u32le(ptr + 38);
+	entry->ofs_local_file_header = get_u32le(ptr + 42);
+	entry->filename = NULL;
+	entry->extra = NULL;
+	entry->comment = NULL;
+	entry->data = NULL;
+	entry->ofs_data = 0;
+	entry->len_padding = 0;
+	entry->generated = false;
+}
+
+/* fill in the fields that didn't fit, which are in the zip64 extra field in this order */
+static bool parse_zip64_extra(const Uint8 *extra, Uint16 len_extra, zip_central_dir_entry_t *entry)
+{
+	Uint64 *fields[4];
+	int num_fields = 0;
+	if (entry->len_file_uncompressed == ZIP_ZIP64_MARKER_32) fields[num_fields++] = &entry->len_file_uncompressed;
+	if (entry->len_file_compressed == ZIP_ZIP64_MARKER_32) fields[num_fields++] = &entry->len_file_compressed;
+	if (entry->ofs_local_file_header == ZIP_ZIP64_MARKER_32) fields[num_fields++] = &entry->ofs_local_file_header;
+
+	if (num_fields == 0)
+		return true;
+
+	const Uint8 *end = extra + len_extra;
+	while (end - extra >= 4)
+	{
+		Uint16 id = get_u16le(extra);
+		Uint16 size = get_u16le(extra + 2);
+		extra += 4;
+
+		if (end - extra < size)
+			break;
+
+		if (id == ZIP_EXTRA_ZIP64)
+		{
+			if (size < num_fields * 8)
+				return false;
+
+			for (int i = 0; i < num_fields; i++)
+				*fields[i] = get_u64le(extra + i * 8);
+
+			return true;
+		}
+
+		extra += size;
+	}
+
+	return false;
+}
+
+/* the size of the zip64 extra field a local header needs, which always has both sizes */
+static Uint16 get_local_zip64_size(Uint64 len_file_compressed, Uint64 len_file_uncompressed)
+{
+	if (len_file_compressed >= ZIP_ZIP64_MARKER_32 || len_file_uncompressed >= ZIP_ZIP64_MARKER_32)
+		return 4 + 16;
+	return 0;
+}
+
+/* the size of the zip64 extra field a central directory entry needs, which only has what doesn't fit */
+static Uint16 get_central_zip64_size(Uint64 len_file_compressed, Uint64 len_file_uncompressed, Uint64 ofs_local_file_header)
+{
+	int num_fields = (len_file_uncompressed >= ZIP_ZIP64_MARKER_32) + (len_file_compressed >= ZIP_ZIP64_MARKER_32) + (ofs_local_file_header >= ZIP_ZIP64_MARKER_32);
+	return num_fields ? (Uint16)(4 + num_fields * 8) : 0;
+}
+
+static bool needs_zip64_central_dir_end(Uint64 num_entries, Uint64 len_directory, Uint64 ofs_directory)
+{
+	return num_entries >= ZIP_ZIP64_MARKER_16 || len_directory >= ZIP_ZIP64_MARKER_32 || ofs_directory >= ZIP_ZIP64_MARKER_32;
+}
+
+static void write_central_dir_entry(SDL_IOStream *io, zip_central_dir_entry_t *entry)
+{
+	/* anything that doesn't fit goes in a zip64 extra field, ahead of any others */
+	Uint16 len_zip64 = get_central_zip64_size(entry->len_file_compressed, entry->len_file_uncompressed, entry->ofs_local_file_header);
+
+	SDL_WriteU16LE(io, entry->signature);
+	SDL_WriteU16LE(io, entry->type);
+	SDL_WriteU16LE(io, entry->version_made_with);
+	SDL_WriteU16LE(io, len_zip64 ? SDL_max(entry->version_needed, ZIP_VERSION_ZIP64) : entry->version_needed);
+	SDL_WriteU16LE(io, entry->flags);
+	SDL_WriteU16LE(io, entry->compression);
+	SDL_WriteU16LE(io, entry->file_time);
+	SDL_WriteU16LE(io, entry->file_date);
+	SDL_WriteU32LE(io, entry->crc32);
+	SDL_WriteU32LE(io, (Uint32)SDL_min(entry->len_file_compressed, ZIP_ZIP64_MARKER_32));
+	SDL_WriteU32LE(io, (Uint32)SDL_min(entry->len_file_uncompressed, ZIP_ZIP64_MARKER_32));
+	SDL_WriteU16LE(io, entry->len_filename);
+	SDL_WriteU16LE(io, len_zip64 + entry->len_extra);
+	SDL_WriteU16LE(io, entry->len_comment);
+	SDL_WriteU16LE(io, (Uint16)entry->disk);
+	SDL_WriteU16LE(io, entry->internal_attributes);
+	SDL_WriteU32LE(io, entry->external_attributes);
+	SDL_WriteU32LE(io, (Uint32)SDL_min(entry->ofs_local_file_header, ZIP_ZIP64_MARKER_32));
+
+	/* fix up filename */
+	for (int i = 0; i < entry->len_filename; i++)
+		if (entry->filename[i] == '\\')
+			entry->filename[i] = '/';
+
+	if (entry->len_filename) SDL_WriteIO(io, entry->filename, entry->len_filename);
+
+	if (len_zip64)
+	{
+		SDL_WriteU16LE(io, ZIP_EXTRA_ZIP64);
+		SDL_WriteU16LE(io, len_zip64 - 4);
+		if (entry->len_file_uncompressed >= ZIP_ZIP64_MARKER_32) SDL_WriteU64LE(io, entry->len_file_uncompressed);
+		if (entry->len_file_compressed >= ZIP_ZIP64_MARKER_32) SDL_WriteU64LE(io, entry->len_file_compressed);
+		if (entry->ofs_local_file_header >= ZIP_ZIP64_MARKER_32) SDL_WriteU64LE(io, entry->ofs_local_file_header);
+	}
+
+	if (entry->len_extra) SDL_WriteIO(io, entry->extra, entry->len_extra);
+	if (entry->len_comment) SDL_WriteIO(io, entry->comment, entry->len_comment);
+}
+
+/* the fixed part only, the filename and extra field are left unread */
+static bool read_local_file_header(SDL_IOStream *io, Sint64 offset, zip_local_file_header_t *header)
+{
+	Uint8 data[ZIP_LOCAL_FILE_HEADER_SIZE];
+
+	if (SDL_SeekIO(io, offset, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(io, data, sizeof(data)) != sizeof(data))
+		return false;
+
+	header->signature = get_u16le(data + 0);
+	header->type = get_u16le(data + 2);
+	header->version_needed = get_u16le(data + 4);
+	header->flags = get_u16le(data + 6);
+	header->compression = get_u16le(data + 8);
+	header->file_time = get_u16le(data + 10);
+	header->file_date = get_u16le(data + 12);
+	header->crc32 = get_u32le(data + 14);
+	header->len_file_compressed = get_u32le(data + 18);
+	header->len_file_uncompressed = get_u32le(data + 22);
+	header->len_filename = get_u16le(data + 26);
+	header->len_extra = get_u16le(data + 28);
+	header->filename = NULL;
+	header->extra = NULL;
+	header->data = NULL;
+
+	return true;
+}
+
+/* for entries that only exist in the output */
+static void make_local_file_header(const zip_central_dir_entry_t *entry, zip_local_file_header_t *header)
+{
+	header->signature = ZIP_MAGIC_SIGNATURE;
+	header->type = ZIP_MAGIC_LOCAL_FILE_HEADER;
+	header->version_needed = entry->version_needed;
+	header->flags = entry->flags;
+	header->compression = entry->compression;
+	header->file_time = entry->file_time;
+	header->file_date = entry->file_date;
+	header->crc32 = entry->crc32;
+	header->len_file_compressed = entry->len_file_compressed;
+	header->len_file_uncompressed = entry->len_file_uncompressed;
+	header->len_filename = entry->len_filename;
+	header->len_extra = 0;
+	header->filename = entry->filename;
+	header->extra = NULL;
+	header->data = NULL;
+}
+
+static void write_local_file_header(SDL_IOStream *io, zip_local_file_header_t *header)
+{
+	/* both sizes go in a zip64 extra field if either doesn't fit, ahead of any others */
+	Uint16 len_zip64 = get_local_zip64_size(header->len_file_compressed, header->len_file_uncompressed);
+
+	SDL_WriteU16LE(io, header->signature);
+	SDL_WriteU16LE(io, header->type);
+	SDL_WriteU16LE(io, len_zip64 ? SDL_max(header->version_needed, ZIP_VERSION_ZIP64) : header->version_needed);
+	SDL_WriteU16LE(io, header->flags);
+	SDL_WriteU16LE(io, header->compression);
+	SDL_WriteU16LE(io, header->file_time);
+	SDL_WriteU16LE(io, header->file_date);
+	SDL_WriteU32LE(io, header->crc32);
+	SDL_WriteU32LE(io, len_zip64 ? ZIP_ZIP64_MARKER_32 : (Uint32)header->len_file_compressed);
+	SDL_WriteU32LE(io, len_zip64 ? ZIP_ZIP64_MARKER_32 : (Uint32)header->len_file_uncompressed);
+	SDL_WriteU16LE(io, header->len_filename);
+	SDL_WriteU16LE(io, len_zip64 + header->len_extra);
+
+	/* fix up filename */
+	for (int i = 0; i < header->len_filename; i++)
+		if (header->filename[i] == '\\')
+			header->filename[i] = '/';
+
+	if (header->len_filename) SDL_WriteIO(io, header->filename, header->len_filename);
+
+	if (len_zip64)
+	{
+		SDL_WriteU16LE(io, ZIP_EXTRA_ZIP64);
+		SDL_WriteU16LE(io, len_zip64 - 4);
+		SDL_WriteU64LE(io, header->len_file_uncompressed);
+		SDL_WriteU64LE(io, header->len_file_compressed);
+	}
+
+	if (header->len_extra) SDL_WriteIO(io, header->extra, header->len_extra);
+}
+
+/* the zip64 end record and the locator that points back at it, which both go right before the end record */
+static void write_zip64_central_dir_end(SDL_IOStream *io, zip_central_dir_end_t *central_dir_end, Uint64 ofs_zip64_central_dir_end)
+{
+	SDL_WriteU16LE(io, ZIP_MAGIC_SIGNATURE);
+	SDL_WriteU16LE(io, ZIP_MAGIC_ZIP64_CENTRAL_DIR_END);
+	SDL_WriteU64LE(io, ZIP_ZIP64_CENTRAL_DIR_END_SIZE - 12);
+	SDL_WriteU16LE(io, ZIP_VERSION_ZIP64);
+	SDL_WriteU16LE(io, ZIP_VERSION_ZIP64);
+	SDL_WriteU32LE(io, central_dir_end->disk);
+	SDL_WriteU32LE(io, central_dir_end->disk_with_central_dir);
+	SDL_WriteU64LE(io, central_dir_end->num_entries_this_disk);
+	SDL_WriteU64LE(io, central_dir_end->num_entries_total);
+	SDL_WriteU64LE(io, central_dir_end->len_directory);
+	SDL_WriteU64LE(io, central_dir_end->ofs_directory);
+
+	SDL_WriteU16LE(io, ZIP_MAGIC_SIGNATURE);
+	SDL_WriteU16LE(io, ZIP_MAGIC_ZIP64_CENTRAL_DIR_LOCATOR);
+	SDL_WriteU32LE(io, central_dir_end->disk_with_central_dir);
+	SDL_WriteU64LE(io, ofs_zip64_central_dir_end);
+	SDL_WriteU32LE(io, central_dir_end->disk + 1);
+}
+
+/* anything that doesn't fit is left for the zip64 end record */
+static void write_central_dir_end(SDL_IOStream *io, zip_central_dir_end_t *central_dir_end)
+{
+	SDL_WriteU16LE(io, central_dir_end->signature);
+	SDL_WriteU16LE(io, central_dir_end->type);
+	SDL_WriteU16LE(io, (Uint16)SDL_min(central_dir_end->disk, ZIP_ZIP64_MARKER_16));
+	SDL_WriteU16LE(io, (Uint16)SDL_min(central_dir_end->disk_with_central_dir, ZIP_ZIP64_MARKER_16));
+	SDL_WriteU16LE(io, (Uint16)SDL_min(central_dir_end->num_entries_this_disk, ZIP_ZIP64_MARKER_16));
+	SDL_WriteU16LE(io, (Uint16)SDL_min(central_dir_end->num_entries_total, ZIP_ZIP64_MARKER_16));
+	SDL_WriteU32LE(io, (Uint32)SDL_min(central_dir_end->len_directory, ZIP_ZIP64_MARKER_32));
+	SDL_WriteU32LE(io, (Uint32)SDL_min(central_dir_end->ofs_directory, ZIP_ZIP64_MARKER_32));
+	SDL_WriteU16LE(io, central_dir_end->len_comment);
+	SDL_WriteIO(io, central_dir_end->comment, central_dir_end->len_comment);
+}
+
+static bool read_zip64_central_dir_end(SDL_IOStream *io, Uint64 offset, Sint64 ofs_locator, zip_central_dir_end_t *central_dir_end)
+{
+	Uint8 data[ZIP_ZIP64_CENTRAL_DIR_END_SIZE];
+
+	if (ofs_locator < ZIP_ZIP64_CENTRAL_DIR_END_SIZE || offset > (Uint64)ofs_locator - ZIP_ZIP64_CENTRAL_DIR_END_SIZE)
+		return false;
+
+	if (SDL_SeekIO(io, (Sint64)offset, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(io, data, sizeof(data)) != sizeof(data))
+		return false;
+
+	if (get_u16le(data + 0) != ZIP_MAGIC_SIGNATURE || get_u16le(data + 2) != ZIP_MAGIC_ZIP64_CENTRAL_DIR_END)
+		return false;
+
+	/* the rest of the record is an extensible data sector, which is ignored */
+	central_dir_end->disk = get_u32le(data + 16);
+	central_dir_end->disk_with_central_dir = get_u32le(data + 20);
+	central_dir_end->num_entries_this_disk = get_u64le(data + 24);
+	central_dir_end->num_entries_total = get_u64le(data + 32);
+	central_dir_end->len_directory = get_u64le(data + 40);
+	central_dir_end->ofs_directory = get_u64le(data + 48);
+
+	return true;
+}
+
+static bool read_central_dir(SDL_IOStream *io, arena_t *arena, zip_central_dir_end_t *central_dir_end, const char *filename)
+{
+	Sint64 file_size = SDL_GetIOSize(io);
+	if (file_size < ZIP_CENTRAL_DIR_END_SIZE)
+	{
+		log_warning("Failed to validate \"%s\" as an Xbox 360 zip file", filename);
+		return false;
+	}
+
+	/* read everything the end record could be in */
+	size_t tail_size = (size_t)SDL_min(file_size, ZIP_CENTRAL_DIR_END_SEARCH_SIZE);
+	Uint8 *tail = SDL_malloc(tail_size);
+	if (SDL_SeekIO(io, file_size - tail_size, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(io, tail, tail_size) != tail_size)
+	{
+		log_warning("Failed to read \"%s\"", filename);
+		SDL_free(tail);
+		return false;
+	}
+
+	/* scan backwards for a signature whose comment fits in what's left of the file */
+	const Uint8 *ptr = NULL;
+	for (size_t i = tail_size - ZIP_CENTRAL_DIR_END_SIZE + 1; i-- > 0;)
+	{
+		if (get_u16le(tail + i) != ZIP_MAGIC_SIGNATURE || get_u16le(tail + i + 2) != ZIP_MAGIC_CENTRAL_DIR_END)
+			continue;
+
+		if (i + ZIP_CENTRAL_DIR_END_SIZE + get_u16le(tail + i + 20) <= tail_size)
+		{
+			ptr = tail + i;
+			break;
+		}
+	}
+
+	if (!ptr)
+	{
+		log_warning("Failed to validate \"%s\" as an Xbox 360 zip file", filename);
+		SDL_free(tail);
+		return false;
+	}
+
+	central_dir_end->signature = get_u16le(ptr + 0);
+	central_dir_end->type = get_u16le(ptr + 2);
+	central_dir_end->disk = get_u16le(ptr + 4);
+	central_dir_end->disk_with_central_dir = get_u16le(ptr + 6);
+	central_dir_end->num_entries_this_disk = get_u16le(ptr + 8);
+	central_dir_end->num_entries_total = get_u16le(ptr + 10);
+	central_dir_end->len_directory = get_u32le(ptr + 12);
+	central_dir_end->ofs_directory = get_u32le(ptr + 16);
+	central_dir_end->len_comment = get_u16le(ptr + 20);
+
+	if (central_dir_end->len_comment)
+	{
+		central_dir_end->comment = arena_alloc(arena, central_dir_end->len_comment + 1);
+		if (!central_dir_end->comment)
+		{
+			SDL_free(tail);
+			return false;
+		}
+
+		central_dir_end->comment[central_dir_end->len_comment] = '\0';
+		SDL_memcpy(central_dir_end->comment, ptr + ZIP_CENTRAL_DIR_END_SIZE, central_dir_end->len_comment);
+	}
+	else
+	{
+		central_dir_end->comment = NULL;
+	}
+
+	Sint64 ofs_central_dir_end = file_size - tail_size + (ptr - tail);
+	SDL_free(tail);
+
+	/* a zip64 end record replaces this one, if there's a locator for it right before this one */
+	if (ofs_central_dir_end >= ZIP_ZIP64_CENTRAL_DIR_LOCATOR_SIZE)
+	{
+		Uint8 locator[ZIP_ZIP64_CENTRAL_DIR_LOCATOR_SIZE];
+		if (SDL_SeekIO(io, ofs_central_dir_end - ZIP_ZIP64_CENTRAL_DIR_LOCATOR_SIZE, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(io, locator, sizeof(locator)) != sizeof(locator))
+		{
+			log_warning("Failed to read \"%s\"", filename);
+			return false;
+		}
+
+		if (get_u16le(locator + 0) == ZIP_MAGIC_SIGNATURE && get_u16le(locator + 2) == ZIP_MAGIC_ZIP64_CENTRAL_DIR_LOCATOR)
+		{
+			Uint64 ofs_zip64_central_dir_end = get_u64le(locator + 8);
+			if (!read_zip64_central_dir_end(io, ofs_zip64_central_dir_end, ofs_central_dir_end - ZIP_ZIP64_CENTRAL_DIR_LOCATOR_SIZE, central_dir_end))
+			{
+				log_warning("Failed to validate the zip64 end record of \"%s\"", filename);
+				return false;
+			}
+
+			ofs_central_dir_end = (Sint64)ofs_zip64_central_dir_end;
+		}
+	}
+
+	/* validate disk numbers */
+	if (central_dir_end->disk != central_dir_end->disk_with_central_dir || central_dir_end->num_entries_this_disk != central_dir_end->num_entries_total)
+	{
+		log_warning("Multi-part zips are not supported");
+		return false;
+	}
+
+	/* the directory has to come before its end */
+	if (central_dir_end->ofs_directory > (Uint64)ofs_central_dir_end || central_dir_end->len_directory > (Uint64)ofs_central_dir_end - central_dir_end->ofs_directory)
+	{
+		log_warning("Central directory of \"%s\" is past its end record", filename);
+		return false;
+	}
+
+	/* every entry takes up at least its fixed part, which also keeps the count in range of an int */
+	if (central_dir_end->num_entries_total > central_dir_end->len_directory / ZIP_CENTRAL_DIR_ENTRY_SIZE || central_dir_end->num_entries_total > SDL_MAX_SINT32 / 4)
+	{
+		log_warning("Central directory of \"%s\" is too small for its %" SDL_PRIu64 " entries", filename, central_dir_end->num_entries_total);
+		return false;
+	}
+
+	return true;
+}
+
+/* FNV-1a over the name the way the engine looks it up, ignoring case and slash direction */
+static Uint32 hash_entry_name(const char *name)
+{
+	Uint32 hash = 2166136261u;
+	for (; *name; name++)
+	{
+		int c = *name == '\\' ? '/' : SDL_tolower((unsigned char)*name);
+		hash = (hash ^ (Uint8)c) * 16777619u;
+	}
+	return hash;
+}
+
+static bool compare_entry_names(const char *a, const char *b)
+{
+	for (; *a && *b; a++, b++)
+	{
+		int ca = *a == '\\' ? '/' : SDL_tolower((unsigned char)*a);
+		int cb = *b == '\\' ? '/' : SDL_tolower((unsigned char)*b);
+		if (ca != cb)
+			return false;
+	}
+	return *a == *b;
+}
+
+static Uint32 get_hash_table_size(int num_entries)
+{
+	/* kept at most half full */
+	Uint32 size = 16;
+	while (size < (Uint32)num_entries * 2)
+		size *= 2;
+	return size;
+}
+
+static bool build_hash_table(zip360_t *zip)
+{
+	int num_entries = (int)zip->central_dir_end.num_entries_total;
+	Uint32 size = get_hash_table_size(num_entries);
+
+	zip->hash_mask = size - 1;
+	zip->hash_table = arena_alloc(zip->arena, sizeof(Sint32) * size);
+	if (!zip->hash_table)
+		return false;
+
+	for (Uint32 i = 0; i < size; i++)
+		zip->hash_table[i] = -1;
+
+	for (int entry = 0; entry < num_entries; entry++)
+	{
+		Uint32 slot = hash_entry_name(zip->entries[entry].filename) & zip->hash_mask;
+		while (zip->hash_table[slot] >= 0)
+			slot = (slot + 1) & zip->hash_mask;
+		zip->hash_table[slot] = entry;
+	}
+
+	return true;
+}
+
+/* padding goes in an extra field of its own, so it's never shorter than one */
+static Uint16 get_padding(Sint64 offset, Uint32 alignment)
+{
+	if (alignment <= 1 || offset % alignment == 0)
+		return 0;
+
+	Uint32 padding = alignment - offset % alignment;
+	while (padding < ZIP_EXTRA_ALIGNMENT_MIN_SIZE)
+		padding += alignment;
+
+	return (Uint16)padding;
+}
+
+static void fill_padding(Uint8 *extra, Uint16 len_padding, Uint32 alignment)
+{
+	Uint16 values[3] = {SDL_Swap16LE(ZIP_EXTRA_ALIGNMENT), SDL_Swap16LE(len_padding - 4), SDL_Swap16LE((Uint16)alignment)};
+	SDL_memset(extra, 0, len_padding);
+	SDL_memcpy(extra, values, sizeof(values));
+}
+
+/* compressed entries count as stored until decompress_zip360() has been through them */
+static void update_output_size(zip360_t *zip)
+{
+	Sint64 position = 0;
+	Sint64 directory_size = 0;
+	for (int i = 0; i < zip->num_order; i++)
+	{
+		zip_central_dir_entry_t *central_dir_entry = &zip->entries[zip->order[i]];
+		bool decompressed = central_dir_entry->compression == ZIP_COMPRESSION_STORED || central_dir_entry->data;
+		Uint64 size = decompressed ? central_dir_entry->len_file_compressed : central_dir_entry->len_file_uncompressed;
+		Sint64 ofs_local_file_header = position;
+
+		/* extra fields and comments are all dropped, besides zip64 fields and padding */
+		position += ZIP_LOCAL_FILE_HEADER_SIZE + central_dir_entry->len_filename + get_local_zip64_size(size, central_dir_entry->len_file_uncompressed);
+		central_dir_entry->len_padding = get_padding(position, zip->alignment);
+		position += central_dir_entry->len_padding + size;
+
+		directory_size += ZIP_CENTRAL_DIR_ENTRY_SIZE + central_dir_entry->len_filename + get_central_zip64_size(size, central_dir_entry->len_file_uncompressed, ofs_local_file_header);
+	}
+
+	zip->output_size = position + directory_size + ZIP_CENTRAL_DIR_END_SIZE;
+	if (needs_zip64_central_dir_end(zip->num_order, directory_size, position))
+		zip->output_size += ZIP_ZIP64_CENTRAL_DIR_END_SIZE + ZIP_ZIP64_CENTRAL_DIR_LOCATOR_SIZE;
+}
+
+static void read_preload_section(zip360_t *zip, int index)
+{
+	zip_central_dir_entry_t *central_dir_entry = &zip->entries[index];
+	zip_local_file_header_t header;
+
+	/* the console reads it directly, so it's always stored, and its offsets are all 32-bit */
+	Uint64 size = central_dir_entry->len_file_compressed;
+	if (central_dir_entry->compression != ZIP_COMPRESSION_STORED || !read_local_file_header(zip->io, central_dir_entry->ofs_local_file_header, &header) || size < ZIP_PRELOAD_SECTION_HEADER_SIZE || size > SDL_MAX_UINT32)
+	{
+		log_warning("Failed to read the preload section of \"%s\"", zip->name);
+		return;
+	}
+
+	Uint8 *data = arena_alloc(zip->arena, (size_t)size);
+	if (!data)
+		return;
+
+	Sint64 offset = (Sint64)central_dir_entry->ofs_local_file_header + ZIP_LOCAL_FILE_HEADER_SIZE + header.len_filename + header.len_extra;
+	if (SDL_SeekIO(zip->io, offset, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(zip->io, data, (size_t)size) != size)
+	{
+		log_warning("Failed to read the preload section of \"%s\"", zip->name);
+		return;
+	}
+
+	zip_preload_section_t *preload_section = arena_calloc(zip->arena, 1, sizeof(zip_preload_section_t));
+	if (!preload_section)
+		return;
+
+	preload_section->version = get_u32be(data + 0);
+	preload_section->num_directory_entries = get_u32be(data + 4);
+	preload_section->num_preload_directory_entries = get_u32be(data + 8);
+	preload_section->alignment = get_u32be(data + 12);
+
+	/* it's only a hint, so anything off about it means it gets ignored */
+	Uint32 num_preload = preload_section->num_preload_directory_entries;
+	if (preload_section->version != ZIP_PRELOAD_SECTION_VERSION || preload_section->num_directory_entries != zip->central_dir_end.num_entries_total)
+	{
+		log_warning("Ignoring preload section version %u of \"%s\"", preload_section->version, zip->name);
+		return;
+	}
+
+	if (num_preload > zip->central_dir_end.num_entries_total || ZIP_PRELOAD_SECTION_HEADER_SIZE + (Uint64)num_preload * (ZIP_PRELOAD_DIRECTORY_ENTRY_SIZE + 2) > size)
+	{
+		log_warning("Ignoring preload section of \"%s\" with %u entries", zip->name, num_preload);
+		return;
+	}
+
+	const Uint8 *ptr = data + ZIP_PRELOAD_SECTION_HEADER_SIZE;
+	preload_section->preload_directory_entries = arena_alloc(zip->arena, sizeof(zip_preload_directory_entry_t) * num_preload);
+	preload_section->preload_directory_indices = arena_alloc(zip->arena, sizeof(Uint16) * num_preload);
+	if (!preload_section->preload_directory_entries || !preload_section->preload_directory_indices)
+		return;
+
+	for (Uint32 i = 0; i < num_preload; i++, ptr += ZIP_PRELOAD_DIRECTORY_ENTRY_SIZE)
+	{
+		preload_section->preload_directory_entries[i].length = get_u32be(ptr);
+		preload_section->preload_directory_entries[i].offset = get_u32be(ptr + 4);
+	}
+
+	for (Uint32 i = 0; i < num_preload; i++, ptr += 2)
+	{
+		preload_section->preload_directory_indices[i] = get_u16be(ptr);
+		if (preload_section->preload_directory_indices[i] >= zip->central_dir_end.num_entries_total)
+		{
+			log_warning("Ignoring preload section of \"%s\" with an out of range index", zip->name);
+			return;
+		}
+	}
+
+	zip->preload_section = preload_section;
+}
+
+zip360_t *open_zip360(SDL_IOStream *io, arena_t *arena, const char *name)
+{
+	zip360_t *zip = arena_calloc(arena, 1, sizeof(zip360_t));
+	if (!zip)
+		return NULL;
+
+	zip->io = io;
+	zip->arena = arena;
+	zip->name = name;
+
+	/* get end of central dir record */
+	Uint64 span = begin_trace_span();
+	if (!read_central_dir(io, arena, &zip->central_dir_end, name))
+		return NULL;
+
+	/* read the whole central dir in one go */
+	int num_entries = (int)zip->central_dir_end.num_entries_total;
+	size_t len_directory = (size_t)zip->central_dir_end.len_directory;
+	Uint8 *directory = arena_alloc(arena, len_directory);
+	bool ok = directory && SDL_SeekIO(io, (Sint64)zip->central_dir_end.ofs_directory, SDL_IO_SEEK_SET) >= 0 && SDL_ReadIO(io, directory, len_directory) == len_directory;
+	end_trace_span(span, "read directory", len_directory, -1, "%s", name);
+
+	if (!ok)
+	{
+		log_warning("Failed to read the central directory of \"%s\"", name);
+		return NULL;
+	}
+
+	/* every filename goes in one pool, which can't be bigger than the directory plus terminators */
+	zip->string_pool = arena_alloc(arena, len_directory + num_entries);
+	char *string = zip->string_pool;
+
+	const Uint8 *ptr = directory;
+	const Uint8 *end = directory + len_directory;
+	/* with room for a preload section to be added */
+	zip->entries = arena_calloc(arena, num_entries + 1, sizeof(zip_central_dir_entry_t));
+	if (!zip->string_pool || !zip->entries)
+		return NULL;
+
+	for (int entry = 0; entry < num_entries; entry++)
+	{
+		zip_central_dir_entry_t *central_dir_entry = &zip->entries[entry];
+
+		if (end - ptr < ZIP_CENTRAL_DIR_ENTRY_SIZE)
+		{
+			log_warning("Central directory entry %d is past the end of the directory", entry);
+			return NULL;
+		}
+
+		parse_central_dir_entry(ptr, central_dir_entry);
+		ptr += ZIP_CENTRAL_DIR_ENTRY_SIZE;
+
+		if (central_dir_entry->signature != ZIP_MAGIC_SIGNATURE || central_dir_entry->type != ZIP_MAGIC_CENTRAL_DIR_ENTRY)
+		{
+			log_warning("Central directory entry %d failed to validate", entry);
+			return NULL;
+		}
+
+		if (end - ptr < (ptrdiff_t)central_dir_entry->len_filename + central_dir_entry->len_extra + central_dir_entry->len_comment)
+		{
+			log_warning("Central directory entry %d is past the end of the directory", entry);
+			return NULL;
+		}
+
+		if (central_dir_entry->compression != ZIP_COMPRESSION_STORED && central_dir_entry->compression != ZIP_COMPRESSION_LZMA)
+		{
+			log_warning("Compression method %d is not supported", central_dir_entry->compression);
+			return NULL;
+		}
+
+		if (!parse_zip64_extra(ptr + central_dir_entry->len_filename, central_dir_entry->len_extra, central_dir_entry))
+		{
+			log_warning("Central directory entry %d is missing its zip64 extra field", entry);
+			return NULL;
+		}
+
+		central_dir_entry->filename = string;
+		SDL_memcpy(string, ptr, central_dir_entry->len_filename);
+		string[central_dir_entry->len_filename] = '\0';
+		string += central_dir_entry->len_filename + 1;
+
+		/* other extra fields and comments are all dropped */
+		ptr += central_dir_entry->len_filename + central_dir_entry->len_extra + central_dir_entry->len_comment;
+	}
+
+	/* written out in the same order until layout_zip360() says otherwise */
+	zip->order = arena_alloc(arena, sizeof(int) * (num_entries + 1));
+	if (!zip->order)
+		return NULL;
+
+	zip->num_order = num_entries;
+	for (int entry = 0; entry < num_entries; entry++)
+		zip->order[entry] = entry;
+
+	update_output_size(zip);
+	if (!build_hash_table(zip))
+		return NULL;
+
+	/* the xbox 360 tools put it first, but don't count on it */
+	zip->preload_index = find_zip360_entry(zip, ZIP_PRELOAD_SECTION_NAME);
+	if (zip->preload_index >= 0)
+		read_preload_section(zip, zip->preload_index);
+
+	return zip;
+}
+
+int find_zip360_entry(const zip360_t *zip, const char *name)
+{
+	Uint32 slot = hash_entry_name(name) & zip->hash_mask;
+	while (zip->hash_table[slot] >= 0)
+	{
+		if (compare_entry_names(zip->entries[zip->hash_table[slot]].filename, name))
+			return zip->hash_table[slot];
+		slot = (slot + 1) & zip->hash_mask;
+	}
+	return -1;
+}
+
+Sint64 get_zip360_output_size(const zip360_t *zip)
+{
+	return zip->output_size;
+}
+
+/* the extension, or an empty string if there isn't one */
+static const char *get_entry_type(const char *filename)
+{
+	const char *type = "";
+	for (const char *c = filename; *c; c++)
+	{
+		if (*c == '.')
+			type = c + 1;
+		else if (*c == '/' || *c == '\\')
+			type = "";
+	}
+	return type;
+}
+
+typedef struct zip_decompression {
+	zip360_t *zip;
+	const Uint8 *memory;
+	Sint64 memory_size;
+	SDL_Mutex *io_lock;
+	bool recompress;
+	SDL_AtomicInt failed;
+} zip_decompression_t;
+
+/* read an entry's compressed data, or point right at it if the zip is in memory */
+static const Uint8 *read_entry_data(zip_decompression_t *decompression, zip_central_dir_entry_t *central_dir_entry)
+{
+	zip360_t *zip = decompression->zip;
+	zip_local_file_header_t header;
+	const Uint8 *data = NULL;
+
+	SDL_LockMutex(decompression->io_lock);
+
+	if (read_local_file_header(zip->io, central_dir_entry->ofs_local_file_header, &header) &&
+		header.signature == ZIP_MAGIC_SIGNATURE && header.type == ZIP_MAGIC_LOCAL_FILE_HEADER)
+	{
+		Sint64 offset = (Sint64)central_dir_entry->ofs_local_file_header + ZIP_LOCAL_FILE_HEADER_SIZE + header.len_filename + header.len_extra;
+		size_t size = (size_t)central_dir_entry->len_file_compressed;
+
+		if (decompression->memory)
+		{
+			if (offset <= decompression->memory_size && size <= (Uint64)(decompression->memory_size - offset))
+				data = decompression->memory + offset;
+		}
+		else
+		{
+			Uint8 *buffer = arena_alloc(zip->arena, size);
+			if (buffer && SDL_SeekIO(zip->io, offset, SDL_IO_SEEK_SET) >= 0 && SDL_ReadIO(zip->io, buffer, size) == size)
+				data = buffer;
+		}
+	}
+
+	SDL_UnlockMutex(decompression->io_lock);
+
+	return data;
+}
+
+static void decompress_entry(void *userdata, int job, int thread)
+{
+	zip_decompression_t *decompression = (zip_decompression_t *)userdata;
+	zip360_t *zip = decompression->zip;
+	zip_central_dir_entry_t *central_dir_entry = &zip->entries[job];
+	(void)thread;
+
+	/* no point in carrying on */
+	if (SDL_GetAtomicInt(&decompression->failed))
+		return;
+
+	/* counters are added up by type, there's too many files to count them one by one */
+	const char *type = get_entry_type(central_dir_entry->filename);
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	const Uint8 *src = read_entry_data(decompression, central_dir_entry);
+	end_perf_sample(&sample, "read", central_dir_entry->len_file_compressed, "*.%s", type);
+	end_trace_span(span, "read", central_dir_entry->len_file_compressed, -1, "%s", central_dir_entry->filename);
+
+	if (!src)
+	{
+		log_warning("Failed to read local file %d from \"%s\"", job, zip->name);
+		SDL_SetAtomicInt(&decompression->failed, 1);
+		return;
+	}
+
+	size_t size = (size_t)central_dir_entry->len_file_uncompressed;
+	Uint8 *data = arena_alloc(zip->arena, size);
+	if (!data)
+	{
+		SDL_SetAtomicInt(&decompression->failed, 1);
+		return;
+	}
+
+	span = begin_trace_span();
+	begin_perf_sample(&sample);
+	bool ok = decompress_lzma_zip_entry(src, (size_t)central_dir_entry->len_file_compressed, data, size);
+	end_perf_sample(&sample, "decompress", size, "*.%s", type);
+	end_trace_span(span, "decompress", central_dir_entry->len_file_compressed, size, "%s", central_dir_entry->filename);
+
+	if (!ok)
+	{
+		log_warning("Failed to decompress \"%s\" in \"%s\"", central_dir_entry->filename, zip->name);
+		SDL_SetAtomicInt(&decompression->failed, 1);
+		return;
+	}
+
+	if (SDL_crc32(0, data, size) != central_dir_entry->crc32)
+	{
+		log_warning("\"%s\" in \"%s\" failed its CRC check", central_dir_entry->filename, zip->name);
+		SDL_SetAtomicInt(&decompression->failed, 1);
+		return;
+	}
+
+	/* anything that doesn't get smaller is stored instead */
+	if (decompression->recompress)
+	{
+		Uint8 *compressed = arena_alloc(zip->arena, size);
+		if (!compressed)
+		{
+			SDL_SetAtomicInt(&decompression->failed, 1);
+			return;
+		}
+
+		span = begin_trace_span();
+		begin_perf_sample(&sample);
+		Sint64 compressed_size = compress_lzma_zip_entry(data, size, compressed, size);
+		end_perf_sample(&sample, "compress", size, "*.%s", type);
+		end_trace_span(span, "compress", size, compressed_size, "%s", central_dir_entry->filename);
+
+		if (compressed_size >= 0)
+		{
+			central_dir_entry->data = compressed;
+			central_dir_entry->len_file_compressed = (Uint64)compressed_size;
+			central_dir_entry->flags |= ZIP_FLAG_LZMA_END_MARKER;
+			central_dir_entry->version_needed = ZIP_VERSION_LZMA;
+			return;
+		}
+	}
+
+	central_dir_entry->data = data;
+	central_dir_entry->compression = ZIP_COMPRESSION_STORED;
+	central_dir_entry->len_file_compressed = size;
+	central_dir_entry->flags &= ~ZIP_FLAG_LZMA_END_MARKER;
+	central_dir_entry->version_needed = ZIP_VERSION_STORED;
+}
+
+static int compare_entry_sizes(void *userdata, const void *a, const void *b)
+{
+	const zip_central_dir_entry_t *entries = (const zip_central_dir_entry_t *)userdata;
+	int left = *(const int *)a;
+	int right = *(const int *)b;
+
+	/* biggest first, ties broken by index so the order is stable */
+	if (entries[left].len_file_uncompressed != entries[right].len_file_uncompressed)
+		return entries[left].len_file_uncompressed > entries[right].len_file_uncompressed ? -1 : 1;
+	return left - right;
+}
+
+bool decompress_zip360(zip360_t *zip, int num_threads, bool recompress)
+{
+	int num_entries = (int)zip->central_dir_end.num_entries_total;
+
+	/* biggest first, so the small ones fill in around them */
+	int num_jobs = 0;
+	int *order = arena_alloc(zip->arena, sizeof(int) * SDL_max(num_entries, 1));
+	if (!order)
+		return false;
+
+	for (int entry = 0; entry < num_entries; entry++)
+		if (zip->entries[entry].compression != ZIP_COMPRESSION_STORED && !zip->entries[entry].data)
+			order[num_jobs++] = entry;
+
+	if (num_jobs == 0)
+		return true;
+
+	SDL_qsort_r(order, num_jobs, sizeof(int), compare_entry_sizes, zip->entries);
+
+	zip_decompression_t decompression;
+	decompression.zip = zip;
+	decompression.recompress = recompress;
+	decompression.io_lock = SDL_CreateMutex();
+	SDL_SetAtomicInt(&decompression.failed, 0);
+
+	/* zips in memory are read in place instead of being copied */
+	SDL_PropertiesID props = SDL_GetIOProperties(zip->io);
+	decompression.memory = SDL_GetPointerProperty(props, SDL_PROP_IOSTREAM_MEMORY_POINTER, NULL);
+	decompression.memory_size = SDL_GetIOSize(zip->io);
+
+	run_jobs(num_jobs, num_threads, order, decompress_entry, &decompression);
+
+	SDL_DestroyMutex(decompression.io_lock);
+
+	if (SDL_GetAtomicInt(&decompression.failed))
+		return false;
+
+	update_output_size(zip);
+
+	return true;
+}
+
+static int compare_entry_types(void *userdata, const void *a, const void *b)
+{
+	const zip_central_dir_entry_t *entries = (const zip_central_dir_entry_t *)userdata;
+	int left = *(const int *)a;
+	int right = *(const int *)b;
+
+	/* by type, then by name so each directory stays together, then by index so the order is stable */
+	int result = SDL_strcasecmp(get_entry_type(entries[left].filename), get_entry_type(entries[right].filename));
+	if (result == 0)
+		result = SDL_strcasecmp(entries[left].filename, entries[right].filename);
+	return result != 0 ? result : left - right;
+}
+
+/* move the access list to the front in its own order, and return how many of it were found, or -1 on error */
+static int apply_access_list(zip360_t *zip, const char **access_list, int num_access_list)
+{
+	int num_entries = (int)zip->central_dir_end.num_entries_total;
+	int *position = arena_alloc(zip->arena, sizeof(int) * num_entries);
+	int *order = arena_alloc(zip->arena, sizeof(int) * (num_entries + 1));
+	if (!position || !order)
+		return -1;
+
+	for (int entry = 0; entry < num_entries; entry++)
+		position[entry] = -1;
+	for (int i = 0; i < zip->num_order; i++)
+		position[zip->order[i]] = i;
+
+	int num_order = 0;
+	int num_missing = 0;
+	for (int i = 0; i < num_access_list; i++)
+	{
+		int entry = find_zip360_entry(zip, access_list[i]);
+		if (entry < 0 || position[entry] < 0)
+		{
+			/* repeats in the list don't count as missing */
+			if (entry < 0)
+				num_missing++;
+			continue;
+		}
+
+		order[num_order++] = entry;
+		position[entry] = -1;
+	}
+
+	int num_found = num_order;
+	for (int i = 0; i < zip->num_order; i++)
+		if (position[zip->order[i]] >= 0)
+			order[num_order++] = zip->order[i];
+
+	if (num_missing > 0)
+		log_warning("%d files in the access list aren't in \"%s\"", num_missing, zip->name);
+
+	zip->order = order;
+	zip->num_order = num_order;
+
+	return num_found;
+}
+
+/* read a stored entry's payload from wherever it is */
+static bool read_stored_entry(zip360_t *zip, zip_central_dir_entry_t *central_dir_entry, Uint8 *dst)
+{
+	size_t size = (size_t)central_dir_entry->len_file_compressed;
+
+	if (central_dir_entry->data)
+	{
+		SDL_memcpy(dst, central_dir_entry->data, size);
+		return true;
+	}
+
+	zip_local_file_header_t header;
+	if (!read_local_file_header(zip->io, central_dir_entry->ofs_local_file_header, &header))
+		return false;
+
+	Sint64 offset = (Sint64)central_dir_entry->ofs_local_file_header + ZIP_LOCAL_FILE_HEADER_SIZE + header.len_filename + header.len_extra;
+	return SDL_SeekIO(zip->io, offset, SDL_IO_SEEK_SET) >= 0 && SDL_ReadIO(zip->io, dst, size) == size;
+}
+
+/* build a preload section for entries at the front of the order, and put it in front of them */
+static bool add_preload_section(zip360_t *zip, const int *preload, int num_preload)
+{
+	int index = (int)zip->central_dir_end.num_entries_total;
+	zip_central_dir_entry_t *central_dir_entry = &zip->entries[index];
+
+	if (zip->num_order + 1 > SDL_MAX_UINT16)
+	{
+		log_warning("\"%s\" has too many files for a preload section", zip->name);
+		return true;
+	}
+
+	/* where each entry ends up once the section is in front of them all, or 0 if it's been dropped */
+	int *position = arena_calloc(zip->arena, index, sizeof(int));
+	int *preloaded = arena_alloc(zip->arena, sizeof(int) * SDL_max(num_preload, 1));
+	if (!position || !preloaded)
+		return false;
+
+	for (int i = 0; i < zip->num_order; i++)
+		position[zip->order[i]] = i + 1;
+
+	/* the console can only preload what it can read directly */
+	int num_preloaded = 0;
+	Uint64 data_size = 0;
+	for (int i = 0; i < num_preload; i++)
+	{
+		zip_central_dir_entry_t *entry = &zip->entries[preload[i]];
+		if (entry->compression != ZIP_COMPRESSION_STORED || position[preload[i]] == 0)
+			continue;
+
+		preloaded[num_preloaded++] = preload[i];
+		data_size += entry->len_file_compressed;
+	}
+
+	if (num_preloaded == 0)
+	{
+		log_warning("Nothing to preload in \"%s\"", zip->name);
+		return true;
+	}
+
+	/* header, directory entries and indices, then the data itself */
+	Uint32 data_offset = ZIP_PRELOAD_SECTION_HEADER_SIZE + num_preloaded * (ZIP_PRELOAD_DIRECTORY_ENTRY_SIZE + 2);
+	data_offset = (data_offset + 3) & ~3;
+
+	/* its offsets are all 32-bit */
+	if (data_size > SDL_MAX_UINT32 - data_offset)
+	{
+		log_warning("Too much to preload in \"%s\"", zip->name);
+		return true;
+	}
+
+	Uint32 size = data_offset + (Uint32)data_size;
+	Uint8 *data = arena_calloc(zip->arena, 1, size);
+	char *filename = arena_alloc(zip->arena, sizeof(ZIP_PRELOAD_SECTION_NAME));
+	if (!data || !filename)
+		return false;
+
+	Uint32 header[4] = {
+		SDL_Swap32BE(ZIP_PRELOAD_SECTION_VERSION),
+		SDL_Swap32BE(zip->num_order + 1),
+		SDL_Swap32BE(num_preloaded),
+		SDL_Swap32BE(zip->alignment)
+	};
+	SDL_memcpy(data, header, sizeof(header));
+
+	Uint8 *ptr = data + ZIP_PRELOAD_SECTION_HEADER_SIZE;
+	Uint8 *indices = ptr + num_preloaded * ZIP_PRELOAD_DIRECTORY_ENTRY_SIZE;
+	Uint32 offset = data_offset;
+	for (int i = 0; i < num_preloaded; i++, ptr += ZIP_PRELOAD_DIRECTORY_ENTRY_SIZE, indices += 2)
+	{
+		zip_central_dir_entry_t *entry = &zip->entries[preloaded[i]];
+
+		if (!read_stored_entry(zip, entry, data + offset))
+		{
+			log_warning("Failed to read \"%s\" from \"%s\" to preload it", entry->filename, zip->name);
+			return false;
+		}
+
+		/* offsets are from the start of the section */
+		Uint32 values[2] = {SDL_Swap32BE((Uint32)entry->len_file_compressed), SDL_Swap32BE(offset)};
+		Uint16 directory_index = SDL_Swap16BE((Uint16)position[preloaded[i]]);
+		SDL_memcpy(ptr, values, sizeof(values));
+		SDL_memcpy(indices, &directory_index, 2);
+
+		offset += (Uint32)entry->len_file_compressed;
+	}
+
+	/* it doesn't exist in the input, so the local header is made from this */
+	SDL_zerop(central_dir_entry);
+	central_dir_entry->signature = ZIP_MAGIC_SIGNATURE;
+	central_dir_entry->type = ZIP_MAGIC_CENTRAL_DIR_ENTRY;
+	central_dir_entry->version_made_with = ZIP_VERSION_STORED;
+	central_dir_entry->version_needed = ZIP_VERSION_STORED;
+	central_dir_entry->compression = ZIP_COMPRESSION_STORED;
+	central_dir_entry->file_time = zip->entries[preloaded[0]].file_time;
+	central_dir_entry->file_date = zip->entries[preloaded[0]].file_date;
+	central_dir_entry->crc32 = SDL_crc32(0, data, size);
+	central_dir_entry->len_file_compressed = size;
+	central_dir_entry->len_file_uncompressed = size;
+	central_dir_entry->len_filename = sizeof(ZIP_PRELOAD_SECTION_NAME) - 1;
+	central_dir_entry->filename = filename;
+	SDL_memcpy(central_dir_entry->filename, ZIP_PRELOAD_SECTION_NAME, sizeof(ZIP_PRELOAD_SECTION_NAME));
+	central_dir_entry->data = data;
+	central_dir_entry->generated = true;
+
+	SDL_memmove(zip->order + 1, zip->order, sizeof(int) * zip->num_order);
+	zip->order[0] = index;
+	zip->num_order++;
+
+	return true;
+}
+
+bool layout_zip360(zip360_t *zip, const zip360_layout_t *layout)
+{
+	int num_entries = (int)zip->central_dir_end.num_entries_total;
+	bool reordered = layout->order_by_type || layout->num_access_list > 0;
+
+	zip->alignment = layout->alignment;
+
+	/* an old preload section indexes the directory and has the alignment in it, so it has to be rebuilt */
+	bool rebuild_preload = zip->preload_index >= 0 && (reordered || layout->alignment > 1);
+	bool add_preload = layout->preload || rebuild_preload;
+
+	zip->num_order = 0;
+	for (int entry = 0; entry < num_entries; entry++)
+		if (!add_preload || entry != zip->preload_index)
+			zip->order[zip->num_order++] = entry;
+
+	if (layout->order_by_type)
+		SDL_qsort_r(zip->order, zip->num_order, sizeof(int), compare_entry_types, zip->entries);
+
+	int num_found = 0;
+	if (layout->num_access_list > 0)
+	{
+		num_found = apply_access_list(zip, layout->access_list, layout->num_access_list);
+		if (num_found < 0)
+			return false;
+	}
+
+	if (add_preload)
+	{
+		/* the access list if there is one, otherwise whatever was preloaded before */
+		const int *preload = zip->order;
+		int num_preload = num_found;
+
+		if (num_found == 0 && zip->preload_section)
+		{
+			int *old = arena_alloc(zip->arena, sizeof(int) * zip->preload_section->num_preload_directory_entries);
+			if (!old)
+				return false;
+
+			for (Uint32 i = 0; i < zip->preload_section->num_preload_directory_entries; i++)
+				old[i] = zip->preload_section->preload_directory_indices[i];
+			preload = old;
+			num_preload = zip->preload_section->num_preload_directory_entries;
+		}
+
+		if (!add_preload_section(zip, preload, num_preload))
+			return false;
+	}
+
+	update_output_size(zip);
+
+	return true;
+}
+
+typedef struct zip_write {
+	zip360_t *zip;
+	output_file_t *output;
+	Sint64 offset;
+	Uint8 **buffers;
+	size_t max_header_size;
+	SDL_AtomicInt failed;
+} zip_write_t;
+
+static void write_entry(void *userdata, int job, int thread)
+{
+	zip_write_t *write = (zip_write_t *)userdata;
+	zip360_t *zip = write->zip;
+	zip_central_dir_entry_t *central_dir_entry = &zip->entries[job];
+	zip_local_file_header_t *header = &central_dir_entry->local_file_header;
+
+	/* no point in carrying on */
+	if (SDL_GetAtomicInt(&write->failed))
+		return;
+
+	/* padding is made after the header in the same buffer */
+	Uint8 *header_data = write->buffers[thread];
+	header->extra = header_data + write->max_header_size;
+	fill_padding(header->extra, header->len_extra, zip->alignment);
+
+	size_t header_size = ZIP_LOCAL_FILE_HEADER_SIZE + header->len_filename + get_local_zip64_size(header->len_file_compressed, header->len_file_uncompressed) + header->len_extra;
+	SDL_IOStream *headerIo = SDL_IOFromMem(header_data, header_size);
+	write_local_file_header(headerIo, header);
+	SDL_CloseIO(headerIo);
+
+	/* everything already knows where it's going */
+	Uint64 span = begin_trace_span();
+	perf_sample_t sample;
+	begin_perf_sample(&sample);
+	Sint64 position = write->offset + (Sint64)central_dir_entry->ofs_local_file_header;
+	bool ok = write_output_file(write->output, position, header_data, header_size);
+
+	/* anything left stored gets copied straight across */
+	if (ok && central_dir_entry->data)
+		ok = write_output_file(write->output, position + header_size, central_dir_entry->data, (size_t)header->len_file_compressed);
+	else if (ok)
+		ok = copy_to_output_file(write->output, position + header_size, zip->io, central_dir_entry->ofs_data, (Sint64)header->len_file_compressed);
+
+	end_perf_sample(&sample, "write", header_size + header->len_file_compressed, "*.%s", get_entry_type(central_dir_entry->filename));
+	end_trace_span(span, "write", central_dir_entry->data ? -1 : (Sint64)header->len_file_compressed, header_size + header->len_file_compressed, "%s", central_dir_entry->filename);
+
+	if (!ok)
+	{
+		log_warning("Failed to copy local file %d from \"%s\"", job, zip->name);
+		SDL_SetAtomicInt(&write->failed, 1);
+	}
+}
+
+static int compare_output_sizes(void *userdata, const void *a, const void *b)
+{
+	const zip_central_dir_entry_t *entries = (const zip_central_dir_entry_t *)userdata;
+	int left = *(const int *)a;
+	int right = *(const int *)b;
+
+	/* biggest first, ties broken by index so the order is stable */
+	if (entries[left].len_file_compressed != entries[right].len_file_compressed)
+		return entries[left].len_file_compressed > entries[right].len_file_compressed ? -1 : 1;
+	return left - right;
+}
+
+bool write_zip360(zip360_t *zip, output_file_t *output, Sint64 offset, int num_threads)
+{
+	zip_central_dir_end_t *central_dir_end = &zip->central_dir_end;
+
+	/* read every local header and work out where everything goes before copying anything */
+	Uint64 position = 0;
+	size_t max_header_size = ZIP_LOCAL_FILE_HEADER_SIZE;
+	for (int i = 0; i < zip->num_order; i++)
+	{
+		int entry = zip->order[i];
+		zip_central_dir_entry_t *central_dir_entry = &zip->entries[entry];
+		zip_local_file_header_t *header = &central_dir_entry->local_file_header;
+
+		if (central_dir_entry->generated)
+		{
+			make_local_file_header(central_dir_entry, header);
+		}
+		else if (!read_local_file_header(zip->io, central_dir_entry->ofs_local_file_header, header))
+		{
+			log_warning("Failed to read local file header %d", entry);
+			return false;
+		}
+
+		if (header->signature != ZIP_MAGIC_SIGNATURE || header->type != ZIP_MAGIC_LOCAL_FILE_HEADER || header->len_filename != central_dir_entry->len_filename)
+		{
+			log_warning("Local file header %d failed to validate", entry);
+			return false;
+		}
+
+		if (central_dir_entry->compression != ZIP_COMPRESSION_STORED && !central_dir_entry->data)
+		{
+			log_warning("Local file %d is compressed, but was never decompressed", entry);
+			return false;
+		}
+
+		central_dir_entry->ofs_data = (Sint64)central_dir_entry->ofs_local_file_header + ZIP_LOCAL_FILE_HEADER_SIZE + header->len_filename + header->len_extra;
+
+		/* the central directory has the real sizes, even if the local header was written before them */
+		header->crc32 = central_dir_entry->crc32;
+		header->len_file_compressed = central_dir_entry->len_file_compressed;
+		header->len_file_uncompressed = central_dir_entry->len_file_uncompressed;
+		header->filename = central_dir_entry->filename;
+		header->len_extra = central_dir_entry->len_padding;
+
+		/* and decompressed entries have been stored or recompressed since */
+		if (central_dir_entry->data)
+		{
+			header->compression = central_dir_entry->compression;
+			header->flags = central_dir_entry->flags;
+			header->version_needed = central_dir_entry->version_needed;
+		}
+
+		size_t header_size = ZIP_LOCAL_FILE_HEADER_SIZE + header->len_filename + get_local_zip64_size(header->len_file_compressed, header->len_file_uncompressed) + header->len_extra;
+		max_header_size = SDL_max(max_header_size, header_size);
+
+		central_dir_entry->ofs_local_file_header = position;
+		position += header_size + header->len_file_compressed;
+	}
+
+	/* copying on several threads only works if nothing has to seek the input */
+	if (!can_copy_concurrently(zip->io))
+		num_threads = 1;
+
+	/* biggest first, so the small ones fill in around them, but otherwise keep the reads in order */
+	const int *order = zip->order;
+	if (num_threads > 1)
+	{
+		int *sorted = arena_alloc(zip->arena, sizeof(int) * zip->num_order);
+		if (!sorted)
+			return false;
+
+		SDL_memcpy(sorted, zip->order, sizeof(int) * zip->num_order);
+		SDL_qsort_r(sorted, zip->num_order, sizeof(int), compare_output_sizes, zip->entries);
+		order = sorted;
+	}
+
+	zip_write_t write;
+	write.zip = zip;
+	write.output = output;
+	write.offset = offset;
+	write.max_header_size = max_header_size;
+	write.buffers = arena_alloc(zip->arena, sizeof(Uint8 *) * num_threads);
+	if (!write.buffers)
+		return false;
+
+	for (int i = 0; i < num_threads; i++)
+	{
+		write.buffers[i] = arena_alloc(zip->arena, max_header_size + SDL_MAX_UINT16);
+		if (!write.buffers[i])
+			return false;
+	}
+
+	SDL_SetAtomicInt(&write.failed, 0);
+
+	run_jobs(zip->num_order, num_threads, order, write_entry, &write);
+
+	if (SDL_GetAtomicInt(&write.failed))
+		return false;
+
+	/* write central dir and its end in one go */
+	size_t directory_size = (size_t)(zip->output_size - position);
+	Uint8 *directory_data = arena_alloc(zip->arena, directory_size);
+	if (!directory_data)
+		return false;
+
+	SDL_IOStream *directoryIo = SDL_IOFromMem(directory_data, directory_size);
+
+	central_dir_end->disk = 0;
+	central_dir_end->disk_with_central_dir = 0;
+	central_dir_end->ofs_directory = position;
+	central_dir_end->num_entries_this_disk = zip->num_order;
+	central_dir_end->num_entries_total = zip->num_order;
+	for (int i = 0; i < zip->num_order; i++)
+	{
+		zip_central_dir_entry_t *central_dir_entry = &zip->entries[zip->order[i]];
+		central_dir_entry->len_extra = 0;
+		central_dir_entry->len_comment = 0;
+		write_central_dir_entry(directoryIo, central_dir_entry);
+	}
+	central_dir_end->len_directory = SDL_TellIO(directoryIo);
+
+	if (needs_zip64_central_dir_end(central_dir_end->num_entries_total, central_dir_end->len_directory, central_dir_end->ofs_directory))
+		write_zip64_central_dir_end(directoryIo, central_dir_end, position + central_dir_end->len_directory);
+
+	/* write central dir end */
+	central_dir_end->len_comment = 0;
+	write_central_dir_end(directoryIo, central_dir_end);
+	SDL_CloseIO(directoryIo);
+
+	Uint64 span = begin_trace_span();
+	bool ok = write_output_file(output, offset + (Sint64)position, directory_data, directory_size);
+	end_trace_span(span, "write directory", -1, directory_size, "%s", zip->name);
+
+	return ok;
+}
+
+Sint64 estimate_zip360_memory(SDL_IOStream *io, const char *name)
+{
+	/* only for the comment and directory */
+	arena_t *arena = create_arena(0);
+	if (!arena)
+	{
+		log_warning("Failed to create arena for \"%s\"", name);
+		return -1;
+	}
+
+	zip_central_dir_end_t central_dir_end;
+	if (!read_central_dir(io, arena, &central_dir_end, name))
+	{
+		destroy_arena(arena);
+		return -1;
+	}
+
+	/* only the central dir is held in memory, stored entries are copied across without being buffered */
+	int num_entries = (int)central_dir_end.num_entries_total;
+	Sint64 total = (Sint64)sizeof(zip_central_dir_entry_t) * num_entries + sizeof(Sint32) * get_hash_table_size(num_entries);
+
+	/* the directory as read, its string pool, and the directory as written */
+	total += (Sint64)central_dir_end.len_directory * 3 + num_entries;
+
+	/* compressed entries are read, decompressed, and maybe recompressed */
+	size_t len_directory = (size_t)central_dir_end.len_directory;
+	Uint8 *directory = arena_alloc(arena, len_directory);
+	if (!directory || SDL_SeekIO(io, (Sint64)central_dir_end.ofs_directory, SDL_IO_SEEK_SET) < 0 || SDL_ReadIO(io, directory, len_directory) != len_directory)
+	{
+		destroy_arena(arena);
+		return -1;
+	}
+
+	const Uint8 *ptr = directory;
+	const Uint8 *end = directory + len_directory;
+	for (int entry = 0; entry < num_entries && end - ptr >= ZIP_CENTRAL_DIR_ENTRY_SIZE; entry++)
+	{
+		zip_central_dir_entry_t central_dir_entry;
+		parse_central_dir_entry(ptr, &central_dir_entry);
+		ptr += ZIP_CENTRAL_DIR_ENTRY_SIZE;
+
+		if (end - ptr < (ptrdiff_t)central_dir_entry.len_filename + central_dir_entry.len_extra + central_dir_entry.len_comment)
+			break;
+
+		parse_zip64_extra(ptr + central_dir_entry.len_filename, central_dir_entry.len_extra, &central_dir_entry);
+
+		if (central_dir_entry.compression != ZIP_COMPRESSION_STORED)
+			total += (Sint64)central_dir_entry.len_file_compressed + (Sint64)central_dir_entry.len_file_uncompressed * 2;
+
+		ptr += central_dir_entry.len_filename + central_dir_entry.len_extra + central_dir_entry.len_comment;
+	}
+
+	destroy_arena(arena);
+
+	return total;
+}
@@ -0,0 +1,139 @@
+
+#ifndef _ZIP360_H_
+#define _ZIP360_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <SDL3/SDL.h>
+
+#include "arena.h"
+#include "output_file.h"
+
+typedef struct zip360 zip360_t;
+
+typedef struct zip360_layout {
+	Uint32 alignment;
+	bool order_by_type;
+	const char **access_list;
+	int num_access_list;
+	bool preload;
+} zip360_layout_t;
+
+/**
+ * \brief read the central directory of an Xbox 360 zip file
+ *
+ * \param io the IOStream to read from, which must stay open while the zip is used
+ * \param arena arena to allocate everything from
+ * \param name name of the zip, for error messages
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the zip, or NULL on error
+ *
+ * \note everything lives in the arena, so there is nothing to close
+ */
+zip360_t *open_zip360(SDL_IOStream *io, arena_t *arena, const char *name);
+
+/**
+ * \brief decompress every LZMA compressed entry in a zip
+ *
+ * \param zip the zip
+ * \param num_threads number of threads to decompress on
+ * \param recompress true to recompress the entries, false to store them
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note entries are decompressed biggest first and held in the zip's arena
+ * until it's written, and their crc32 and sizes are checked and updated
+ * \note must be called before get_zip360_output_size() or write_zip360()
+ * if the zip has compressed entries
+ */
+bool decompress_zip360(zip360_t *zip, int num_threads, bool recompress);
+
+/**
+ * \brief choose the order and alignment of the files in the converted zip
+ *
+ * \param zip the zip
+ * \param layout how to lay the files out
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note payloads are padded to start on a multiple of layout->alignment
+ * from the start of the zip, using an extra field in the local header
+ * \note files are sorted by type if layout->order_by_type is set, then
+ * anything in layout->access_list is moved to the front in that order
+ * \note a preload section for the access list is put first if
+ * layout->preload is set, and one that was already in the zip is rebuilt
+ * if the layout would make it wrong
+ * \note must be called after decompress_zip360(), and before
+ * get_zip360_output_size() or write_zip360()
+ */
+bool layout_zip360(zip360_t *zip, const zip360_layout_t *layout);
+
+/**
+ * \brief get the size of the converted zip file
+ *
+ * \param zip the zip
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the size in bytes
+ */
+Sint64 get_zip360_output_size(const zip360_t *zip);
+
+/**
+ * \brief find an entry in a zip by name
+ *
+ * \param zip the zip
+ * \param name name of the entry
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the index of the entry in the central directory, or -1 if it isn't there
+ *
+ * \note names are matched the way the engine does, ignoring case and slash direction
+ */
+int find_zip360_entry(const zip360_t *zip, const char *name);
+
+/**
+ * \brief convert a zip and write it into an output file
+ *
+ * \param zip the zip
+ * \param output output file to write to
+ * \param offset offset in the output file to write the zip at
+ * \param num_threads number of threads to copy files on
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns true on success, false on error
+ *
+ * \note the zip takes exactly get_zip360_output_size() bytes at offset, and
+ * the offsets inside it are relative to the start of the zip
+ * \note every file's offset is worked out first, then they're copied
+ * straight to where they go, with the central directory written last
+ * \note files are only copied on more than one thread if
+ * can_copy_concurrently() says the input allows it
+ */
+bool write_zip360(zip360_t *zip, output_file_t *output, Sint64 offset, int num_threads);
+
+/**
+ * \brief estimate the memory needed to convert a zip file
+ *
+ * \param io the IOStream to read from
+ * \param name name of the zip, for error messages
+ *
+ * \author erysdren (it/its)
+ *
+ * \returns the estimated number of bytes, or -1 on error
+ */
+Sint64 estimate_zip360_memory(SDL_IOStream *io, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ZIP360_H_ */
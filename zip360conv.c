@@ -1,69 +1,22 @@
 
 #include <SDL3/SDL.h>
 
+#include "arena.h"
+#include "batch.h"
 #include "decompress_lzma.h"
+#include "memory_tracker.h"
+#include "output_file.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "utils.h"
+#include "zip360.h"
 
-#define ZIP_MAGIC_SIGNATURE 0x4b50
-#define ZIP_MAGIC_CENTRAL_DIR_ENTRY 0x0201
-#define ZIP_MAGIC_LOCAL_FILE_HEADER 0x0403
-#define ZIP_MAGIC_CENTRAL_DIR_END 0x0605
-
-typedef struct zip_central_dir_end {
-	Uint16 signature;
-	Uint16 type;
-	Uint16 disk;
-	Uint16 disk_with_central_dir;
-	Uint16 num_entries_this_disk;
-	Uint16 num_entries_total;
-	Uint32 len_directory;
-	Uint32 ofs_directory;
-	Uint16 len_comment;
-	char *comment;
-} zip_central_dir_end_t;
-
-typedef struct zip_local_file_header {
-	Uint16 signature;
-	Uint16 type;
-	Uint16 version_needed;
-	Uint16 flags;
-	Uint16 compression;
-	Uint16 file_time;
-	Uint16 file_date;
-	Uint32 crc32;
-	Uint32 len_file_compressed;
-	Uint32 len_file_uncompressed;
-	Uint16 len_filename;
-	Uint16 len_extra;
-	char *filename;
-	void *extra;
-	void *data;
-} zip_local_file_header_t;
-
-typedef struct zip_central_dir_entry {
-	Uint16 signature;
-	Uint16 type;
-	Uint16 version_made_with;
-	Uint16 version_needed;
-	Uint16 flags;
-	Uint16 compression;
-	Uint16 file_time;
-	Uint16 file_date;
-	Uint32 crc32;
-	Uint32 len_file_compressed;
-	Uint32 len_file_uncompressed;
-	Uint16 len_filename;
-	Uint16 len_extra;
-	Uint16 len_comment;
-	Uint16 disk;
-	Uint16 internal_attributes;
-	Uint32 external_attributes;
-	Uint32 ofs_local_file_header;
-	char *filename;
-	void *extra;
-	char *comment;
-	zip_local_file_header_t local_file_header;
-} zip_central_dir_entry_t;
+typedef struct zip_options {
+	int num_threads;
+	bool recompress;
+	zip360_layout_t layout;
+} zip_options_t;
 
 static void make_output_filename(const char *input, char *output, size_t output_size)
 {
@@ -85,328 +38,261 @@ static void make_output_filename(const char *input, char *output, size_t output_
 	}
 }
 
-static void read_central_dir_entry(SDL_IOStream *io, zip_central_dir_entry_t *entry)
+static Sint64 estimate_zip_memory(const char *filename, void *userdata)
 {
-	SDL_ReadU16LE(io, &entry->signature);
-	SDL_ReadU16LE(io, &entry->type);
-	SDL_ReadU16LE(io, &entry->version_made_with);
-	SDL_ReadU16LE(io, &entry->version_needed);
-	SDL_ReadU16LE(io, &entry->flags);
-	SDL_ReadU16LE(io, &entry->compression);
-	SDL_ReadU16LE(io, &entry->file_time);
-	SDL_ReadU16LE(io, &entry->file_date);
-	SDL_ReadU32LE(io, &entry->crc32);
-	SDL_ReadU32LE(io, &entry->len_file_compressed);
-	SDL_ReadU32LE(io, &entry->len_file_uncompressed);
-	SDL_ReadU16LE(io, &entry->len_filename);
-	SDL_ReadU16LE(io, &entry->len_extra);
-	SDL_ReadU16LE(io, &entry->len_comment);
-	SDL_ReadU16LE(io, &entry->disk);
-	SDL_ReadU16LE(io, &entry->internal_attributes);
-	SDL_ReadU32LE(io, &entry->external_attributes);
-	SDL_ReadU32LE(io, &entry->ofs_local_file_header);
-
-	if (entry->len_filename)
-	{
-		entry->filename = SDL_malloc(entry->len_filename + 1);
-		entry->filename[entry->len_filename] = '\0';
-		SDL_ReadIO(io, entry->filename, entry->len_filename);
-	}
-	else
-	{
-		entry->filename = NULL;
-	}
+	(void)userdata;
 
-#if 0
-	if (entry->len_extra)
-	{
-		entry->extra = SDL_malloc(entry->len_extra);
-		SDL_ReadIO(io, entry->extra, entry->len_extra);
-	}
-	else
-	{
-		entry->extra = NULL;
-	}
+	SDL_IOStream *inputIo = SDL_IOFromFile(filename, "rb");
+	if (!inputIo)
+		return -1;
 
-	if (entry->len_comment)
-	{
-		entry->comment = SDL_malloc(entry->len_comment + 1);
-		entry->comment[entry->len_comment] = '\0';
-		SDL_ReadIO(io, entry->comment, entry->len_comment);
-	}
-	else
-	{
-		entry->comment = NULL;
-	}
-#else
-	entry->extra = NULL;
-	entry->comment = NULL;
-#endif
-}
+	Sint64 total = estimate_zip360_memory(inputIo, filename);
 
-static void write_central_dir_entry(SDL_IOStream *io, zip_central_dir_entry_t *entry)
-{
-	SDL_WriteU16LE(io, entry->signature);
-	SDL_WriteU16LE(io, entry->type);
-	SDL_WriteU16LE(io, entry->version_made_with);
-	SDL_WriteU16LE(io, entry->version_needed);
-	SDL_WriteU16LE(io, entry->flags);
-	SDL_WriteU16LE(io, entry->compression);
-	SDL_WriteU16LE(io, entry->file_time);
-	SDL_WriteU16LE(io, entry->file_date);
-	SDL_WriteU32LE(io, entry->crc32);
-	SDL_WriteU32LE(io, entry->len_file_compressed);
-	SDL_WriteU32LE(io, entry->len_file_uncompressed);
-	SDL_WriteU16LE(io, entry->len_filename);
-	SDL_WriteU16LE(io, entry->len_extra);
-	SDL_WriteU16LE(io, entry->len_comment);
-	SDL_WriteU16LE(io, entry->disk);
-	SDL_WriteU16LE(io, entry->internal_attributes);
-	SDL_WriteU32LE(io, entry->external_attributes);
-	SDL_WriteU32LE(io, entry->ofs_local_file_header);
-
-	/* fix up filename */
-	for (int i = 0; i < entry->len_filename; i++)
-		if (entry->filename[i] == '\\')
-			entry->filename[i] = '/';
-
-	if (entry->len_filename) SDL_WriteIO(io, entry->filename, entry->len_filename);
-	if (entry->len_extra) SDL_WriteIO(io, entry->extra, entry->len_extra);
-	if (entry->len_comment) SDL_WriteIO(io, entry->comment, entry->len_comment);
+	SDL_CloseIO(inputIo);
+
+	return total;
 }
 
-static void read_local_file_header(SDL_IOStream *io, zip_local_file_header_t *header)
+static void convert_zip(const char *filename, void *userdata)
 {
-	SDL_ReadU16LE(io, &header->signature);
-	SDL_ReadU16LE(io, &header->type);
-	SDL_ReadU16LE(io, &header->version_needed);
-	SDL_ReadU16LE(io, &header->flags);
-	SDL_ReadU16LE(io, &header->compression);
-	SDL_ReadU16LE(io, &header->file_time);
-	SDL_ReadU16LE(io, &header->file_date);
-	SDL_ReadU32LE(io, &header->crc32);
-	SDL_ReadU32LE(io, &header->len_file_compressed);
-	SDL_ReadU32LE(io, &header->len_file_uncompressed);
-	SDL_ReadU16LE(io, &header->len_filename);
-	SDL_ReadU16LE(io, &header->len_extra);
-
-	if (header->len_filename)
+	const zip_options_t *options = (const zip_options_t *)userdata;
+
+	log_info("Processing \"%s\"", filename);
+
+	set_memory_file(filename);
+	set_memory_stage("read");
+
+	Uint64 span = begin_trace_span();
+	output_file_t *output = NULL;
+	arena_t *arena = NULL;
+
+	/* open input file */
+	SDL_IOStream *inputIo = SDL_IOFromFile(filename, "rb");
+	if (!inputIo)
 	{
-		header->filename = SDL_malloc(header->len_filename + 1);
-		header->filename[header->len_filename] = '\0';
-		SDL_ReadIO(io, header->filename, header->len_filename);
+		log_warning("Failed to open \"%s\" for reading", filename);
+		goto cleanup;
 	}
-	else
+
+	/* only the central dir and compressed files get read into memory */
+	arena = create_arena(0);
+	if (!arena)
 	{
-		header->filename = NULL;
+		log_warning("Failed to create arena for \"%s\"", filename);
+		goto cleanup;
 	}
 
-	if (header->len_extra)
+	/* read central dir */
+	zip360_t *zip = open_zip360(inputIo, arena, filename);
+	if (!zip)
+		goto cleanup;
+
+	/* compressed files change size, so they're done before the output is opened */
+	set_memory_stage("decompress");
+	if (!decompress_zip360(zip, options->num_threads, options->recompress))
+		goto cleanup;
+
+	set_memory_stage("layout");
+	if (!layout_zip360(zip, &options->layout))
+		goto cleanup;
+
+	/* get output filename */
+	char outputFilename[1024];
+	make_output_filename(filename, outputFilename, sizeof(outputFilename));
+
+	/* open output file at its final size */
+	output = open_output_file(outputFilename, get_zip360_output_size(zip));
+	if (!output)
+		goto cleanup;
+
+	/* write files */
+	set_memory_stage("write");
+	if (!write_zip360(zip, output, 0, options->num_threads))
 	{
-		header->extra = SDL_malloc(header->len_extra + 1);
-		SDL_ReadIO(io, header->extra, header->len_extra);
+		log_warning("Failed to write \"%s\"", outputFilename);
+		goto cleanup;
 	}
+
+	/* move output file into place */
+	set_memory_stage("save");
+	Uint64 saveSpan = begin_trace_span();
+	perf_sample_t saveSample;
+	begin_perf_sample(&saveSample);
+	bool saved = commit_output_file(output);
+	output = NULL;
+	end_perf_sample(&saveSample, "save", get_zip360_output_size(zip), "zip");
+	end_trace_span(saveSpan, "save", -1, get_zip360_output_size(zip), "%s", outputFilename);
+
+	if (!saved)
+		log_warning("Failed to save \"%s\"", outputFilename);
 	else
-	{
-		header->extra = NULL;
-	}
+		log_info("Successfully Saved \"%s\"", outputFilename);
 
-	header->data = SDL_malloc(header->len_file_compressed);
-	SDL_ReadIO(io, header->data, header->len_file_compressed);
-}
+	/* clean up */
+cleanup:
+	if (output) discard_output_file(output);
+	if (arena) destroy_arena(arena);
+	if (inputIo) SDL_CloseIO(inputIo);
 
-static void write_local_file_header(SDL_IOStream *io, zip_local_file_header_t *header)
-{
-	SDL_WriteU16LE(io, header->signature);
-	SDL_WriteU16LE(io, header->type);
-	SDL_WriteU16LE(io, header->version_needed);
-	SDL_WriteU16LE(io, header->flags);
-	SDL_WriteU16LE(io, header->compression);
-	SDL_WriteU16LE(io, header->file_time);
-	SDL_WriteU16LE(io, header->file_date);
-	SDL_WriteU32LE(io, header->crc32);
-	SDL_WriteU32LE(io, header->len_file_compressed);
-	SDL_WriteU32LE(io, header->len_file_uncompressed);
-	SDL_WriteU16LE(io, header->len_filename);
-	SDL_WriteU16LE(io, header->len_extra);
-
-	/* fix up filename */
-	for (int i = 0; i < header->len_filename; i++)
-		if (header->filename[i] == '\\')
-			header->filename[i] = '/';
-
-	if (header->len_filename) SDL_WriteIO(io, header->filename, header->len_filename);
-	if (header->len_extra) SDL_WriteIO(io, header->extra, header->len_extra);
-	if (header->len_file_compressed) SDL_WriteIO(io, header->data, header->len_file_compressed);
+	end_trace_span(span, "convert", -1, -1, "%s", filename);
 }
 
-static void read_central_dir_end(SDL_IOStream *io, zip_central_dir_end_t *central_dir_end)
+/* one filename per line, modified in place */
+static const char **load_access_list(const char *filename, char **text, int *num_names)
 {
-	SDL_ReadU16LE(io, &central_dir_end->signature);
-	SDL_ReadU16LE(io, &central_dir_end->type);
-	SDL_ReadU16LE(io, &central_dir_end->disk);
-	SDL_ReadU16LE(io, &central_dir_end->disk_with_central_dir);
-	SDL_ReadU16LE(io, &central_dir_end->num_entries_this_disk);
-	SDL_ReadU16LE(io, &central_dir_end->num_entries_total);
-	SDL_ReadU32LE(io, &central_dir_end->len_directory);
-	SDL_ReadU32LE(io, &central_dir_end->ofs_directory);
-	SDL_ReadU16LE(io, &central_dir_end->len_comment);
-
-	if (central_dir_end->len_comment)
+	size_t size;
+	*num_names = 0;
+	*text = SDL_LoadFile(filename, &size);
+	if (!*text)
 	{
-		central_dir_end->comment = SDL_malloc(central_dir_end->len_comment + 1);
-		central_dir_end->comment[central_dir_end->len_comment] = '\0';
-		SDL_ReadIO(io, central_dir_end->comment, central_dir_end->len_comment);
+		log_warning("Failed to load access list \"%s\"", filename);
+		return NULL;
 	}
-	else
+
+	int max_names = 1;
+	for (size_t i = 0; i < size; i++)
+		if ((*text)[i] == '\n')
+			max_names++;
+
+	const char **names = SDL_malloc(sizeof(char *) * max_names);
+
+	char *line = *text;
+	while (line)
 	{
-		central_dir_end->comment = NULL;
+		char *next = SDL_strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		size_t len = SDL_strlen(line);
+		while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t'))
+			line[--len] = '\0';
+
+		if (len > 0)
+			names[(*num_names)++] = line;
+
+		line = next;
 	}
+
+	return names;
 }
 
-static void write_central_dir_end(SDL_IOStream *io, zip_central_dir_end_t *central_dir_end)
+static void print_usage(void)
 {
-	SDL_WriteU16LE(io, central_dir_end->signature);
-	SDL_WriteU16LE(io, central_dir_end->type);
-	SDL_WriteU16LE(io, central_dir_end->disk);
-	SDL_WriteU16LE(io, central_dir_end->disk_with_central_dir);
-	SDL_WriteU16LE(io, central_dir_end->num_entries_this_disk);
-	SDL_WriteU16LE(io, central_dir_end->num_entries_total);
-	SDL_WriteU32LE(io, central_dir_end->len_directory);
-	SDL_WriteU32LE(io, central_dir_end->ofs_directory);
-	SDL_WriteU16LE(io, central_dir_end->len_comment);
-	SDL_WriteIO(io, central_dir_end->comment, central_dir_end->len_comment);
+	log_info("Usage: zip360conv [-a bytes] [-c] [-j threads] [-l file] [-P] [-t] [-p files] [-m megabytes] [--trace file] [--perf file] [--memory] file.360.zip ...");
+	log_info("  -a bytes      start each file's data on a multiple of this many bytes (a power of two)");
+	log_info("  -c            recompress compressed files with LZMA instead of storing them");
+	log_info("  -j threads    decompress and copy files on this many threads (0 = one per core)");
+	log_info("  -l file       put the files listed in this file first, in the order they're listed");
+	log_info("  -P            add a preload section for the files from -l");
+	log_info("  -t            group files by type");
+	log_info("  -p files      convert this many files at once (0 = one per core)");
+	log_info("  -m megabytes  keep the memory reserved by files converting at once under this limit");
+	log_info("  --trace file  write how long every step took to this file, for Perfetto or chrome://tracing");
+	log_info("  --perf file   count cycles, cache misses and more for every step and write them to this file as CSV (- = log a table)");
+	log_info("  --memory      count allocations and peak memory use for every file and step");
 }
 
 int main(int argc, char **argv)
 {
+	/* has to be installed before anything is allocated */
 	for (int arg = 1; arg < argc; arg++)
-	{
-		log_info("Processing \"%s\"", argv[arg]);
+		if (SDL_strcmp(argv[arg], "--memory") == 0)
+			install_memory_tracker();
 
-		/* open input file */
-		SDL_IOStream *inputIo = SDL_IOFromFile(argv[arg], "rb");
-		if (!inputIo)
-		{
-			log_warning("Failed to open \"%s\" for reading", argv[arg]);
-			goto cleanup;
-		}
+	zip_options_t options;
+	options.num_threads = 1;
+	options.recompress = false;
+	SDL_zero(options.layout);
 
-		/* open temporary buffer for writing */
-		SDL_IOStream *outputIo = SDL_IOFromDynamicMem();
-		if (!outputIo)
-		{
-			log_warning("Failed to create output buffer");
-			goto cleanup;
-		}
+	char *accessListText = NULL;
 
-		/* get end of central dir record */
-		/* NOTE: assumes comment length of 32 bytes, which xbox 360 zip use */
-		zip_central_dir_end_t central_dir_end;
-		SDL_SeekIO(inputIo, -54, SDL_IO_SEEK_END);
-		read_central_dir_end(inputIo, &central_dir_end);
+	int num_batch_threads = 1;
+	Sint64 memory_budget = 0;
+	const char *traceFilename = NULL;
+	const char *perfFilename = NULL;
 
-		/* validate magic */
-		if (central_dir_end.signature != ZIP_MAGIC_SIGNATURE || central_dir_end.type != ZIP_MAGIC_CENTRAL_DIR_END)
-		{
-			log_warning("Failed to validate \"%s\" as an Xbox 360 zip file", argv[arg]);
-			goto cleanup;
-		}
+	int num_files = 0;
+	char **filenames = SDL_malloc(sizeof(char *) * argc);
 
-		/* validate disk numbers */
-		if (central_dir_end.disk != central_dir_end.disk_with_central_dir || central_dir_end.num_entries_this_disk != central_dir_end.num_entries_total)
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (SDL_strcmp(argv[arg], "--memory") == 0)
+			continue;
+
+		if (SDL_strcmp(argv[arg], "-c") == 0 || SDL_strcmp(argv[arg], "-P") == 0 || SDL_strcmp(argv[arg], "-t") == 0)
 		{
-			log_warning("Multi-part zips are not supported");
-			goto cleanup;
+			if (argv[arg][1] == 'c')
+				options.recompress = true;
+			else if (argv[arg][1] == 'P')
+				options.layout.preload = true;
+			else
+				options.layout.order_by_type = true;
+
+			continue;
 		}
 
-		/* read central dir entries */
-		SDL_SeekIO(inputIo, central_dir_end.ofs_directory, SDL_IO_SEEK_SET);
-		zip_central_dir_entry_t *entries = SDL_malloc(sizeof(zip_central_dir_entry_t) * central_dir_end.num_entries_total);
-		for (int entry = 0; entry < central_dir_end.num_entries_total; entry++)
+		if (SDL_strcmp(argv[arg], "-a") == 0 || SDL_strcmp(argv[arg], "-l") == 0 || SDL_strcmp(argv[arg], "-j") == 0 || SDL_strcmp(argv[arg], "-p") == 0 || SDL_strcmp(argv[arg], "-m") == 0 || SDL_strcmp(argv[arg], "--trace") == 0 || SDL_strcmp(argv[arg], "--perf") == 0)
 		{
-			read_central_dir_entry(inputIo, &entries[entry]);
-
-			if (entries[entry].signature != ZIP_MAGIC_SIGNATURE || entries[entry].type != ZIP_MAGIC_CENTRAL_DIR_ENTRY)
+			if (arg + 1 >= argc)
 			{
-				log_warning("Central directory entry %d failed to validate", entry);
-				goto cleanup;
+				print_usage();
+				num_files = 0;
+				break;
 			}
 
-			if (entries[entry].compression != 0)
+			if (SDL_strcmp(argv[arg], "--trace") == 0)
+				traceFilename = argv[arg + 1];
+			else if (SDL_strcmp(argv[arg], "--perf") == 0)
+				perfFilename = argv[arg + 1];
+			else if (argv[arg][1] == 'a')
+				options.layout.alignment = (Uint32)SDL_atoi(argv[arg + 1]);
+			else if (argv[arg][1] == 'l')
 			{
-				log_warning("Compressed files are not supported");
-				goto cleanup;
+				SDL_free(options.layout.access_list);
+				SDL_free(accessListText);
+				options.layout.access_list = load_access_list(argv[arg + 1], &accessListText, &options.layout.num_access_list);
 			}
+			else if (argv[arg][1] == 'j')
+				options.num_threads = get_num_workers(SDL_atoi(argv[arg + 1]));
+			else if (argv[arg][1] == 'p')
+				num_batch_threads = get_num_workers(SDL_atoi(argv[arg + 1]));
+			else
+				memory_budget = SDL_strtoll(argv[arg + 1], NULL, 10) * 1024 * 1024;
+
+			arg++;
+			continue;
 		}
 
-		/* read files */
-		for (int entry = 0; entry < central_dir_end.num_entries_total; entry++)
-		{
-			SDL_SeekIO(inputIo, entries[entry].ofs_local_file_header, SDL_IO_SEEK_SET);
-			read_local_file_header(inputIo, &entries[entry].local_file_header);
-		}
-
-		/* write files */
-		for (int entry = 0; entry < central_dir_end.num_entries_total; entry++)
-		{
-			entries[entry].ofs_local_file_header = SDL_TellIO(outputIo);
-			entries[entry].local_file_header.len_extra = 0;
-			write_local_file_header(outputIo, &entries[entry].local_file_header);
-		}
-
-		/* write central dir */
-		central_dir_end.ofs_directory = SDL_TellIO(outputIo);
-		for (int entry = 0; entry < central_dir_end.num_entries_total; entry++)
-		{
-			entries[entry].len_extra = 0;
-			entries[entry].len_comment = 0;
-			write_central_dir_entry(outputIo, &entries[entry]);
-		}
-		central_dir_end.len_directory = SDL_TellIO(outputIo) - central_dir_end.ofs_directory;
-
-		/* write central dir end */
-		central_dir_end.len_comment = 0;
-		write_central_dir_end(outputIo, &central_dir_end);
+		filenames[num_files++] = argv[arg];
+	}
 
-		/* get output filename */
-		char outputFilename[1024];
-		make_output_filename(argv[arg], outputFilename, sizeof(outputFilename));
+	/* padding has to fit in an extra field */
+	Uint32 alignment = options.layout.alignment;
+	if (alignment > 32768 || (alignment & (alignment - 1)) != 0)
+	{
+		log_warning("Alignment must be a power of two up to 32768");
+		print_usage();
+		num_files = 0;
+	}
 
-		/* get pointer to the buffer we wrote */
-		Sint64 outputSize = SDL_GetIOSize(outputIo);
-		SDL_PropertiesID outputProps = SDL_GetIOProperties(outputIo);
-		void *outputData = SDL_GetPointerProperty(outputProps, SDL_PROP_IOSTREAM_DYNAMIC_MEMORY_POINTER, NULL);
+	if (traceFilename && num_files > 0)
+		open_trace(traceFilename);
+	if (perfFilename && num_files > 0)
+		open_perf_counters(perfFilename);
 
-		/* save output file */
-		if (!SDL_SaveFile(outputFilename, outputData, outputSize))
-			log_warning("Failed to save \"%s\"", outputFilename);
-		else
-			log_info("Successfully Saved \"%s\"", outputFilename);
+	run_batch(num_files, filenames, num_batch_threads, memory_budget, estimate_zip_memory, convert_zip, &options);
 
-		/* clean up */
-cleanup:
-		if (central_dir_end.comment)
-			SDL_free(central_dir_end.comment);
+	close_trace();
+	close_perf_counters();
 
-		if (entries)
-		{
-			for (int entry = 0; entry < central_dir_end.num_entries_total; entry++)
-			{
-				if (entries[entry].filename) SDL_free(entries[entry].filename);
-				if (entries[entry].extra) SDL_free(entries[entry].extra);
-				if (entries[entry].comment) SDL_free(entries[entry].comment);
-				if (entries[entry].local_file_header.filename) SDL_free(entries[entry].local_file_header.filename);
-				if (entries[entry].local_file_header.extra) SDL_free(entries[entry].local_file_header.extra);
-				if (entries[entry].local_file_header.data) SDL_free(entries[entry].local_file_header.data);
-			}
+	free_lzma_pool();
+	free_arena_cache();
 
-			SDL_free(entries);
-		}
+	SDL_free(options.layout.access_list);
+	SDL_free(accessListText);
+	SDL_free(filenames);
 
-		if (inputIo) SDL_CloseIO(inputIo);
-		if (outputIo) SDL_CloseIO(outputIo);
-	}
+	report_memory_tracker();
 
 	SDL_Quit();
 
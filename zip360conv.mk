@@ -10,7 +10,7 @@ BINEXT?=
 OBJEXT?=.o
 
 EXEC?=zip360conv$(BINEXT)
-OBJS=zip360conv$(OBJEXT) decompress_lzma$(OBJEXT) utils$(OBJEXT)
+OBJS=zip360conv$(OBJEXT) arena$(OBJEXT) batch$(OBJEXT) decompress_lzma$(OBJEXT) memory_tracker$(OBJEXT) output_file$(OBJEXT) perf_counters$(OBJEXT) thread_pool$(OBJEXT) trace$(OBJEXT) utils$(OBJEXT) zip360$(OBJEXT)
 
 all: $(EXEC)
 